@@ -0,0 +1,647 @@
+//=============================================================================
+// *** Nunchuk64 ***
+// Copyright (c) Robert Grasböck, All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//=============================================================================
+/// @file   bench.c
+/// @author Robert Grasböck (robert.grasboeck@gmail.com)
+/// @date   October, 2026
+/// @brief  cycle counts of the hot paths, run on simavr ("make bench")
+///
+/// Every function is called with fixed inputs and timed with a timer at
+/// clk/1. The results are printed to the simavr console as CSV:
+///   name,calls,min,max,avg   (cycles per call, call overhead removed)
+/// The ISRs are called directly, their max is the worst case seen.
+/// int0_latency_us is measured with real interrupts: SENSE edge to the
+/// start of Timer1 in INT0, the spread (max - min) is the paddle jitter.
+/// The *_us rows are in us (timer1 at clk/8), with the 1 ms tick running.
+/// frame_us_* is the bus time of one frame per ControllerID against the
+/// controller simulated by bench/simbench: the fused read + read request
+/// and, as frame_split_us_*, read and read request as two transactions
+/// like the old controller_read().
+/// main_block_* is how long the main loop can't run per frame: the whole
+/// blocking read like the old controller_read() (us), against the start
+/// of a read and one controller_poll() pass while it is in flight (cycles).
+/// latency_us_* is end of a port's read to its pins written: right after
+/// the read, and as latency_split_us_* with the other port's read (A) or
+/// commit (B) in front, like the old main loop committed both ports.
+/// Extra defines for a comparison: make clean; make bench BENCH_DEFS=...
+/// (-DCONTROLLER_DECRYPT adds the decrypt rows, -DISR_NESTING=0 gives
+/// int0_latency_us with blocking tick, TWI and port B window ISRs).
+//=============================================================================
+#include <stdio.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include <util/delay_basic.h>
+
+#include "avr_mcu_section.h"
+
+#include "controller.h"
+#include "driver_nunchuk.h"
+#include "driver_wii_classic.h"
+#include "i2c_master.h"
+#include "ioconfig.h"
+#include "joystick.h"
+#include "led.h"
+#include "paddle.h"
+#include "selector.h"
+#include "timer.h"
+
+AVR_MCU(F_CPU, "atmega328p");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+// the ISRs, called like functions (they return with reti)
+extern void TIMER2_COMPA_vect(void);
+extern void INT0_vect(void);
+extern void INT1_vect(void);
+extern void TIMER0_OVF_vect(void);
+
+#ifdef CONTROLLER_DECRYPT
+// decrypt() of controller.c, only built with BENCH
+extern void controller_decrypt(uint8_t *data, uint8_t len);
+#endif
+
+#define CALLS     100  ///< calls per function
+#define ISR_CALLS 1000 ///< timer ticks for the worst case, one second
+
+/// \brief result of one benchmark
+typedef struct {
+  uint16_t calls; ///< number of calls
+  uint16_t min;   ///< fastest call [cycles]
+  uint16_t max;   ///< slowest call [cycles]
+  uint32_t sum;   ///< all calls [cycles]
+} Result;
+
+static uint16_t overhead0; ///< cycles of an empty measurement with timer0
+static uint16_t overhead1; ///< cycles of an empty measurement with timer1
+
+/// cycles of STMT, timer1 at clk/1 (max 65535, 0xFFFF on overflow)
+#define CYCLES1(STMT) ({                              \
+  TCCR1B = 0; TCNT1 = 0; TIFR1 = _BV(TOV1);           \
+  TCCR1B = _BV(CS10);                                 \
+  STMT;                                               \
+  TCCR1B = 0;                                         \
+  (TIFR1 & _BV(TOV1)) ? 0xFFFF : TCNT1 - overhead1; })
+
+/// us of STMT, timer1 at clk/8 (max 65535, 0xFFFF on overflow)
+#define MICROS1(STMT) ({                              \
+  TCCR1B = 0; TCNT1 = 0; TIFR1 = _BV(TOV1);           \
+  TCCR1B = _BV(CS11);                                 \
+  STMT;                                               \
+  TCCR1B = 0;                                         \
+  (TIFR1 & _BV(TOV1)) ? 0xFFFF : TCNT1; })
+
+/// cycles of STMT, timer0 at clk/1 (max 255, 0xFFFF on overflow)
+/// only for INT0, which restarts timer1
+#define CYCLES0(STMT) ({                              \
+  TCCR0B = 0; TCNT0 = 0; TIFR0 = _BV(TOV0);           \
+  TCCR0B = _BV(CS00);                                 \
+  STMT;                                               \
+  TCCR0B = 0;                                         \
+  (TIFR0 & _BV(TOV0)) ? 0xFFFF : TCNT0 - overhead0; })
+
+// ============================================================================
+// console
+
+static int console_putchar(char c, FILE *stream) {
+  (void)stream;
+  GPIOR0 = c;
+  return 0;
+}
+
+static FILE console = FDEV_SETUP_STREAM(console_putchar, NULL, _FDEV_SETUP_WRITE);
+
+static void result_clear(Result *r) {
+  r->calls = 0;
+  r->min = 0xFFFF;
+  r->max = 0;
+  r->sum = 0;
+}
+
+static void result_add(Result *r, uint16_t cycles) {
+  r->calls++;
+  if (cycles < r->min) r->min = cycles;
+  if (cycles > r->max) r->max = cycles;
+  r->sum += cycles;
+}
+
+static void result_print(const char *name, const Result *r) {
+  printf_P(PSTR("CSV,%S,%u,%u,%u,%lu\n"), name, r->calls, r->min, r->max,
+           r->sum / r->calls);
+}
+
+static void result_print_id(const char *name, const char *id, const Result *r) {
+  printf_P(PSTR("CSV,%S%S,%u,%u,%u,%lu\n"), name, id, r->calls, r->min, r->max,
+           r->sum / r->calls);
+}
+
+// ============================================================================
+// simulated controller (bench/simbench)
+
+#define SIM_ADDR (0x52 << 1) ///< device address of the simulated controller
+
+/// write registers of the simulated controller, it answers from then on
+static void sim_poke(uint8_t reg, const uint8_t *data, uint8_t len) {
+  GPIOR2 = reg;
+  while (len--)
+    GPIOR1 = *data++;
+}
+
+// ============================================================================
+// benchmarks
+
+/// fixed frames: stick to the upper right, some buttons pressed
+static const ContollerData NUNCHUK_FRAME = {
+  .byte = { 0xE0, 0xE0, 0x80, 0x80, 0x80, 0x02 },
+#ifdef CONTROLLER_HIRES
+  .format = DATA_FORMAT_STD
+#endif
+};
+
+static const ContollerData CLASSIC_FRAME = {
+  .byte = { 0x3C, 0xBE, 0x7F, 0x60, 0xAE, 0x3E },
+#ifdef CONTROLLER_HIRES
+  .format = DATA_FORMAT_STD
+#endif
+};
+
+#ifdef CONTROLLER_HIRES
+static const ContollerData CLASSIC_FRAME_HIRES = {
+  .byte = { 0xF0, 0x20, 0x80, 0x80, 0x00, 0x00, 0xAE, 0x3E },
+  .format = DATA_FORMAT_HIRES
+};
+#endif
+
+/// data registers of the simulated controller, two frames to see changes
+static const uint8_t SIM_DATA[2][8] = {
+  { 0xF0, 0x20, 0x80, 0x80, 0x00, 0x00, 0xAE, 0x3E },
+  { 0x10, 0xE0, 0x40, 0xC0, 0x00, 0x00, 0xFF, 0xFF }
+};
+
+static const char ID_NUNCHUCK[]      PROGMEM = "nunchuck";
+static const char ID_CLASSIC[]       PROGMEM = "wii_classic";
+static const char ID_CLASSIC_PRO[]   PROGMEM = "wii_classic_pro";
+static const char ID_NES_CLONE[]     PROGMEM = "nes_clone_encrypted";
+static const char ID_SF30[]          PROGMEM = "8bitdo_sf30";
+static const char ID_GEN_NUNCHUK[]   PROGMEM = "generic_nunchuk";
+static const char ID_GEN_CLASSIC[]   PROGMEM = "generic_classic";
+
+/// \brief id bytes the simulated controller reports
+typedef struct {
+  uint8_t id[6];    ///< registers 0xfa ... 0xff
+  const char *name; ///< row name (PROGMEM)
+} SimId;
+
+static const SimId SIM_IDS[] = {
+  {{0x00, 0x00, 0xa4, 0x20, 0x00, 0x00}, ID_NUNCHUCK},
+  {{0x00, 0x00, 0xa4, 0x20, 0x01, 0x01}, ID_CLASSIC},
+  {{0x01, 0x00, 0xa4, 0x20, 0x01, 0x01}, ID_CLASSIC_PRO},
+  {{0x01, 0x00, 0xa4, 0x20, 0x00, 0x01}, ID_NES_CLONE},
+  {{0x00, 0x00, 0xa4, 0x20, 0x00, 0x01}, ID_SF30},
+  {{0x02, 0x00, 0xa4, 0x20, 0x00, 0x00}, ID_GEN_NUNCHUK},
+  {{0x02, 0x00, 0xa4, 0x20, 0x00, 0x01}, ID_GEN_CLASSIC}
+};
+
+#define SIM_IDS_NUMBER (sizeof(SIM_IDS) / sizeof(SIM_IDS[0]))
+
+static void bench_joystick_update(Port port, const char *name) {
+  static const Joystick STATES[2] = {
+    UP | RIGHT | BUTTON | BUTTON2,
+    DOWN | LEFT | BUTTON3
+  };
+  Result r;
+  uint16_t i;
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    Joystick state = STATES[i & 1];
+    result_add(&r, CYCLES1(joystick_update_port(port, state, TRUE)));
+  }
+  joystick_update_port(port, 0, TRUE);
+  result_print(name, &r);
+}
+
+static void bench_driver(const Driver *drv, const ContollerData *cd,
+                         const char *name) {
+  Result r;
+  Joystick joystick;
+  uint16_t i;
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++)
+    result_add(&r, CYCLES1(drv->get_joystick_state(cd, &joystick)));
+  result_print(name, &r);
+}
+
+static void bench_driver_paddle(const Driver *drv, const ContollerData *cd,
+                                const char *name) {
+  Result r;
+  Paddle paddle;
+  uint16_t i;
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++)
+    result_add(&r, CYCLES1(drv->get_paddle_state(cd, &paddle)));
+  result_print(name, &r);
+}
+
+static void bench_paddle_update(Port port, const char *name) {
+  Result r;
+  Paddle paddle;
+  uint16_t i;
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    paddle.axis_x = (i * 37) & 0x3FF;
+    paddle.axis_y = 0x3FF - paddle.axis_x;
+    result_add(&r, CYCLES1(paddle_update_port(port, &paddle)));
+  }
+  result_print(name, &r);
+}
+
+#ifdef CONTROLLER_DECRYPT
+static void bench_decrypt(uint8_t len, const char *name) {
+  uint8_t data[8] = { 0xE0, 0xE0, 0x80, 0x80, 0x80, 0x02, 0xAE, 0x3E };
+  Result r;
+  uint16_t i;
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++)
+    result_add(&r, CYCLES1(controller_decrypt(data, len)));
+  result_print(name, &r);
+}
+#endif
+
+static void bench_isr_paddle(void) {
+  Result r;
+  uint16_t i;
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    result_add(&r, CYCLES0(INT0_vect()));
+    cli();
+  }
+  TCCR1B = 0;
+  result_print(PSTR("isr_int0"), &r);
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    result_add(&r, CYCLES1(INT1_vect()));
+    cli();
+  }
+  TCCR0B = 0;
+  result_print(PSTR("isr_int1"), &r);
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    result_add(&r, CYCLES1(TIMER0_OVF_vect()));
+    cli();
+  }
+  TIMSK0 = 0;
+  result_print(PSTR("isr_timer0_ovf"), &r);
+}
+
+static void bench_isr_timer(void) {
+  Result r;
+  uint16_t i;
+
+  // worst case: all autofire lines of both ports running, led pattern on
+  joystick_update_port(PORT_A, AUTOFIRE | AUTOFIRE2 | AUTOFIRE3, TRUE);
+  joystick_update_port(PORT_B, AUTOFIRE | AUTOFIRE2 | AUTOFIRE3, TRUE);
+  led_overlay(LED_QUICK2);
+
+  result_clear(&r);
+  for (i = 0; i < ISR_CALLS; i++) {
+    result_add(&r, CYCLES1(TIMER2_COMPA_vect()));
+    cli();
+  }
+  joystick_update_port(PORT_A, 0, TRUE);
+  joystick_update_port(PORT_B, 0, TRUE);
+  result_print(PSTR("isr_timer2"), &r);
+}
+
+static void bench_int0_latency(void) {
+  Result r;
+  uint16_t i;
+
+  // busy timer ISR: all autofire lines of both ports running, led pattern on
+  joystick_update_port(PORT_A, AUTOFIRE | AUTOFIRE2 | AUTOFIRE3, TRUE);
+  joystick_update_port(PORT_B, AUTOFIRE | AUTOFIRE2 | AUTOFIRE3, TRUE);
+  led_overlay(LED_QUICK2);
+  timer_init();
+
+  // SENSE A driven by the bench, high
+  PORT_SENSE_A |= _BV(BIT_SENSE_A);
+  DDR_SENSE_A  |= _BV(BIT_SENSE_A);
+  paddle_start(PORT_A);
+
+  // time base: timer0 at clk/8, same prescaler as timer1 in INT0
+  TCCR0A = 0;
+  TCCR0B = _BV(CS01);
+  sei();
+
+  result_clear(&r);
+  for (i = 0; i < ISR_CALLS; i++) {
+    uint8_t edge, now, start;
+
+    // edges at all phases of the 1 ms tick
+    _delay_loop_2(1 + (i * 97) % 1000);
+
+    TCCR1B = 0;
+    edge = TCNT0;
+    PORT_SENSE_A &= ~_BV(BIT_SENSE_A); // SID discharges: INT0
+
+    while (TCCR1B == 0)
+      ;
+
+    cli();
+    now = TCNT0;
+    start = now - TCNT1;               // timer1 started from 0 in INT0
+    sei();
+
+    result_add(&r, (uint8_t)(start - edge));
+    PORT_SENSE_A |= _BV(BIT_SENSE_A);
+  }
+
+  cli();
+  TIMSK2 = 0;
+  TCCR0B = 0;
+  TCCR1B = 0;
+  paddle_stop(PORT_A);
+  DDR_SENSE_A  &= ~_BV(BIT_SENSE_A);
+  PORT_SENSE_A &= ~_BV(BIT_SENSE_A);
+  joystick_update_port(PORT_A, 0, TRUE);
+  joystick_update_port(PORT_B, 0, TRUE);
+  result_print(PSTR("int0_latency_us"), &r);
+}
+
+static void bench_controller_read(void) {
+  ContollerData cd;
+  Result r;
+  uint16_t i;
+
+  // the simulated controller doesn't answer yet: this is the NACK path,
+  // with the 1 ms timer running for the timeouts (its ticks are part of
+  // the count), in us as it takes longer than timer1 counts cycles
+  timer_init();
+  sei();
+  controller_select(PORT_A);
+
+  result_clear(&r);
+  for (i = 0; i < 10; i++)
+    result_add(&r, MICROS1(controller_read(&cd)));
+  cli();
+  TIMSK2 = 0;
+  result_print(PSTR("controller_read_nack_us"), &r);
+}
+
+/// one frame like controller_poll() reads it, driven by the TWI interrupt
+static void read_frame(ContollerData *cd) {
+  controller_request(cd);
+  while (controller_poll() == READ_BUSY)
+    ;
+}
+
+/// one frame like the old controller_read(): read, then the read request
+static void read_frame_split(ContollerData *cd) {
+  uint8_t len = 6;
+  uint8_t i;
+
+#ifdef CONTROLLER_HIRES
+  // format of the last read_frame()
+  if (cd->format == DATA_FORMAT_HIRES)
+    len = 8;
+#endif
+
+  if (i2c_start(SIM_ADDR | I2C_READ) == I2C_OK) {
+    for (i = 0; i < len - 1; i++)
+      i2c_readAck(&cd->byte[i]);
+    i2c_readNak(&cd->byte[i]);
+  }
+  i2c_stop();
+
+  if (i2c_start(SIM_ADDR | I2C_WRITE) == I2C_OK)
+    i2c_write(0x00);
+  i2c_stop();
+}
+
+static void bench_bus_frame(void) {
+  ContollerData cd;
+  Result r;
+  uint16_t i;
+
+  timer_init();
+  sei();
+  controller_select(PORT_A);
+
+  for (uint8_t n = 0; n < SIM_IDS_NUMBER; n++) {
+    ControllerID id;
+
+    sim_poke(0x00, SIM_DATA[0], sizeof(SIM_DATA[0]));
+    sim_poke(0xFA, SIM_IDS[n].id, sizeof(SIM_IDS[n].id));
+
+    // detection sets the clock and the frame size of this id
+    if (get_id(&id) != I2C_OK || id == MAX_IDs)
+      continue;
+
+    result_clear(&r);
+    for (i = 0; i < CALLS; i++)
+      result_add(&r, MICROS1(read_frame(&cd)));
+    result_print_id(PSTR("frame_us_"), SIM_IDS[n].name, &r);
+
+    result_clear(&r);
+    for (i = 0; i < CALLS; i++)
+      result_add(&r, MICROS1(read_frame_split(&cd)));
+    result_print_id(PSTR("frame_split_us_"), SIM_IDS[n].name, &r);
+  }
+
+  cli();
+  TIMSK2 = 0;
+}
+
+static void bench_main_block(void) {
+  ContollerData cd;
+  Result r, poll;
+  ControllerID id;
+  uint16_t i;
+
+  timer_init();
+  sei();
+  controller_select(PORT_A);
+
+  sim_poke(0x00, SIM_DATA[0], sizeof(SIM_DATA[0]));
+  sim_poke(0xFA, SIM_IDS[0].id, sizeof(SIM_IDS[0].id));
+  get_id(&id);
+
+  // before: the main loop waits for the whole frame
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    read_frame(&cd); // frame format of this id
+    result_add(&r, MICROS1(read_frame_split(&cd)));
+  }
+  result_print(PSTR("main_block_us_blocking"), &r);
+
+  // after: start the read, then one pass per poll while the bus is busy
+  result_clear(&r);
+  result_clear(&poll);
+  for (i = 0; i < CALLS; i++) {
+    ReadState rs;
+
+    result_add(&r, CYCLES1(controller_request(&cd)));
+    do {
+      uint16_t cycles = CYCLES1(rs = controller_poll());
+
+      if (rs == READ_BUSY)
+        result_add(&poll, cycles);
+    } while (rs == READ_BUSY);
+  }
+  result_print(PSTR("main_block_request"), &r);
+  result_print(PSTR("main_block_poll_busy"), &poll);
+
+  cli();
+  TIMSK2 = 0;
+}
+
+/// decode and commit a classic controller frame, like main does
+static void deliver(Port port, const ContollerData *cd) {
+  Joystick joystick;
+  Paddle paddle;
+
+  drv_wii_classic.get_joystick_state(cd, &joystick);
+  drv_wii_classic.get_paddle_state(cd, &paddle);
+  joystick_update_port(port, joystick, TRUE);
+  paddle_update_port(port, &paddle);
+}
+
+static void read_port(Port port, ContollerData *cd) {
+  controller_select(port);
+  read_frame(cd);
+}
+
+static void bench_latency(void) {
+  ContollerData cd[NUMBER_PORTS];
+  Result r;
+  uint16_t i;
+
+  timer_init();
+  sei();
+
+  // classic controller on both ports
+  sim_poke(0x00, SIM_DATA[0], sizeof(SIM_DATA[0]));
+  for (Port p = PORT_A; p <= PORT_B; p++) {
+    ControllerID id;
+
+    sim_poke(0xFA, SIM_IDS[1].id, sizeof(SIM_IDS[1].id));
+    controller_select(p);
+    get_id(&id);
+  }
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    sim_poke(0x00, SIM_DATA[i & 1], sizeof(SIM_DATA[0]));
+    read_port(PORT_A, &cd[PORT_A]);
+    result_add(&r, MICROS1(deliver(PORT_A, &cd[PORT_A])));
+  }
+  result_print(PSTR("latency_us_a"), &r);
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    sim_poke(0x00, SIM_DATA[i & 1], sizeof(SIM_DATA[0]));
+    read_port(PORT_A, &cd[PORT_A]);
+    result_add(&r, MICROS1({ read_port(PORT_B, &cd[PORT_B]); deliver(PORT_A, &cd[PORT_A]); }));
+  }
+  result_print(PSTR("latency_split_us_a"), &r);
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    sim_poke(0x00, SIM_DATA[i & 1], sizeof(SIM_DATA[0]));
+    read_port(PORT_B, &cd[PORT_B]);
+    result_add(&r, MICROS1(deliver(PORT_B, &cd[PORT_B])));
+  }
+  result_print(PSTR("latency_us_b"), &r);
+
+  result_clear(&r);
+  for (i = 0; i < CALLS; i++) {
+    sim_poke(0x00, SIM_DATA[i & 1], sizeof(SIM_DATA[0]));
+    read_port(PORT_A, &cd[PORT_A]);
+    read_port(PORT_B, &cd[PORT_B]);
+    result_add(&r, MICROS1({ deliver(PORT_A, &cd[PORT_A]); deliver(PORT_B, &cd[PORT_B]); }));
+  }
+  result_print(PSTR("latency_split_us_b"), &r);
+
+  cli();
+  TIMSK2 = 0;
+  joystick_update_port(PORT_A, 0, TRUE);
+  joystick_update_port(PORT_B, 0, TRUE);
+}
+
+// ============================================================================
+// main
+
+int main(void) {
+  stdout = &console;
+
+  overhead0 = 0;
+  overhead1 = 0;
+  overhead0 = CYCLES0();
+  overhead1 = CYCLES1();
+
+  selector_init();
+  i2c_init();
+  joystick_init();
+  paddle_init();
+  led_init();
+
+  printf_P(PSTR("CSV,name,calls,min,max,avg\n"));
+
+  bench_joystick_update(PORT_A, PSTR("joystick_update_port_a"));
+  bench_joystick_update(PORT_B, PSTR("joystick_update_port_b"));
+
+  bench_driver(&drv_nunchuk, &NUNCHUK_FRAME, PSTR("nunchuk_get_joystick_state"));
+  bench_driver(&drv_wii_classic, &CLASSIC_FRAME, PSTR("classic_get_joystick_state"));
+#ifdef CONTROLLER_HIRES
+  bench_driver(&drv_wii_classic, &CLASSIC_FRAME_HIRES,
+               PSTR("classic_get_joystick_state_hires"));
+#endif
+  bench_driver_paddle(&drv_nunchuk, &NUNCHUK_FRAME, PSTR("nunchuk_get_paddle_state"));
+  bench_driver_paddle(&drv_wii_classic, &CLASSIC_FRAME, PSTR("classic_get_paddle_state"));
+
+#ifdef CONTROLLER_DECRYPT
+  bench_decrypt(6, PSTR("controller_decrypt_6"));
+  bench_decrypt(8, PSTR("controller_decrypt_8"));
+#endif
+
+  bench_paddle_update(PORT_A, PSTR("paddle_update_port_a"));
+  bench_paddle_update(PORT_B, PSTR("paddle_update_port_b"));
+
+  bench_isr_paddle();
+  bench_isr_timer();
+  bench_int0_latency();
+
+  // the simulated controller answers from the first sim_poke() on
+  bench_controller_read();
+  bench_bus_frame();
+  bench_main_block();
+  bench_latency();
+
+  // sleep with interrupts off ends the simulation
+  cli();
+  sleep_enable();
+  sleep_cpu();
+
+  return 0;
+}
@@ -0,0 +1,154 @@
+//=============================================================================
+// *** Nunchuk64 ***
+// Copyright (c) Robert Grasböck, All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//=============================================================================
+/// @file   simbench.c
+/// @author Robert Grasböck (robert.grasboeck@gmail.com)
+/// @date   October, 2026
+/// @brief  host side of the benchmark: runs bench.elf on libsimavr with a
+///         simulated controller on the TWI bus ("make bench")
+///
+/// The controller is a register file at 0x52 like the real ones: a write
+/// sets the register pointer and writes the following bytes, a read
+/// returns the bytes from the pointer on. The id is at 0xfa ... 0xff, the
+/// data at 0x00. It doesn't answer before the bench wrote a register:
+///   GPIOR2 ... register pointer for GPIOR1
+///   GPIOR1 ... write the register, pointer + 1
+/// Both ports see the same controller, the selector isn't modelled.
+/// The console (GPIOR0) is set up from the AVR_MCU section of bench.elf.
+//=============================================================================
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "avr_twi.h"
+
+#define CONTROLLER_ADDR (0x52 << 1) ///< device address, R/W bit clear
+#define GPIOR1_ADDR     0x4A        ///< atmega328p data space address
+#define GPIOR2_ADDR     0x4B        ///< atmega328p data space address
+
+/// \brief simulated controller
+typedef struct {
+  avr_irq_t *irq;    ///< TWI_IRQ_INPUT / TWI_IRQ_OUTPUT
+  uint8_t reg[256];  ///< registers
+  uint8_t ptr;       ///< register pointer
+  uint8_t poke;      ///< register written by the bench
+  uint8_t present;   ///< answers on the bus
+  uint8_t selected;  ///< addressed, address byte with R/W bit
+  uint8_t index;     ///< bytes written since the start
+} Controller;
+
+static Controller controller;
+
+static const char *IRQ_NAMES[2] = {
+  [TWI_IRQ_INPUT]  = "8>controller.out",
+  [TWI_IRQ_OUTPUT] = "32<controller.in",
+};
+
+static void twi_hook(struct avr_irq_t *irq, uint32_t value, void *param) {
+  Controller *c = (Controller *)param;
+  avr_twi_msg_irq_t v;
+
+  (void)irq;
+  v.u.v = value;
+
+  if (v.u.twi.msg & TWI_COND_STOP)
+    c->selected = 0;
+
+  if (v.u.twi.msg & TWI_COND_START) {
+    c->selected = 0;
+    c->index = 0;
+
+    if (c->present && (v.u.twi.addr & 0xFE) == CONTROLLER_ADDR) {
+      c->selected = v.u.twi.addr;
+      avr_raise_irq(c->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, c->selected, 1));
+    }
+  }
+
+  if (c->selected == 0)
+    return;
+
+  if (v.u.twi.msg & TWI_COND_WRITE) {
+    avr_raise_irq(c->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, c->selected, 1));
+
+    // first byte: register pointer
+    if (c->index++ == 0)
+      c->ptr = v.u.twi.data;
+    else
+      c->reg[c->ptr++] = v.u.twi.data;
+  }
+
+  if (v.u.twi.msg & TWI_COND_READ)
+    avr_raise_irq(c->irq + TWI_IRQ_INPUT,
+                  avr_twi_irq_msg(TWI_COND_READ, c->selected, c->reg[c->ptr++]));
+}
+
+static void poke_ptr(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+  (void)avr; (void)addr;
+  ((Controller *)param)->poke = v;
+}
+
+static void poke_reg(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+  Controller *c = (Controller *)param;
+
+  (void)avr; (void)addr;
+  c->reg[c->poke++] = v;
+  c->present = 1;
+}
+
+int main(int argc, char *argv[]) {
+  elf_firmware_t f = {{0}};
+  avr_t *avr;
+  int state = cpu_Running;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s bench.elf\n", argv[0]);
+    return 1;
+  }
+
+  if (elf_read_firmware(argv[1], &f) != 0) {
+    fprintf(stderr, "%s: can't load %s\n", argv[0], argv[1]);
+    return 1;
+  }
+
+  if ((avr = avr_make_mcu_by_name(f.mmcu)) == NULL) {
+    fprintf(stderr, "%s: unknown mcu %s\n", argv[0], f.mmcu);
+    return 1;
+  }
+
+  avr_init(avr);
+  avr_load_firmware(avr, &f);
+
+  // controller on the TWI bus
+  controller.irq = avr_alloc_irq(&avr->irq_pool, 0, 2, IRQ_NAMES);
+  avr_irq_register_notify(controller.irq + TWI_IRQ_OUTPUT, twi_hook, &controller);
+  avr_connect_irq(controller.irq + TWI_IRQ_INPUT,
+                  avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+  avr_connect_irq(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT),
+                  controller.irq + TWI_IRQ_OUTPUT);
+
+  // registers written by the bench
+  avr_register_io_write(avr, GPIOR2_ADDR, poke_ptr, &controller);
+  avr_register_io_write(avr, GPIOR1_ADDR, poke_reg, &controller);
+
+  // bench.elf sleeps with interrupts off when it's done
+  while (state != cpu_Done && state != cpu_Crashed)
+    state = avr_run(avr);
+
+  return (state == cpu_Done) ? 0 : 1;
+}
@@ -25,99 +25,92 @@
 
 #include "button.h"
 
-static volatile uint8_t button_down = FALSE;
-static volatile uint8_t button_down_long = FALSE;
+#define QUEUE_SIZE 4 ///< button events, power of 2
+
+static volatile uint8_t queue[QUEUE_SIZE];
+static volatile uint8_t queue_head = 0; ///< written by button_tick()
+static volatile uint8_t queue_tail = 0; ///< read by button_get_event()
 
 void button_init(void) {
   BIT_SET(PORT_BUTTON, BIT_BUTTON); // Enable internal pullup resistor on the input pin
   BIT_CLEAR(DDR_BUTTON, BIT_BUTTON); // pin is input
 }
 
-// Check button state and set the button_down variable if a debounced
-// button down press is detected.
-// Call this function about 100 times per second.
-void button_debounce(void) {
-  static uint8_t count = 0; // counter for number of equal states
-  static uint8_t button_state = 1; // current (debounced) state
-  static uint8_t button_trigger = FALSE; // trigger button down
+static void put_event(ButtonEvent event) {
+  uint8_t next = (queue_head + 1) & (QUEUE_SIZE - 1);
+
+  // queue full, drop the event
+  if (next == queue_tail)
+    return;
+
+  queue[queue_head] = event;
+  queue_head = next;
+}
 
-  static uint8_t count_long = 0; // counter for number of equal states
-  static uint8_t button_state_long = 1; // current (debounced) state
+// Check button state every millisecond, and queue the events.
+void button_tick(void) {
+  static uint8_t  pressed = FALSE;             // current (debounced) state
+  static uint8_t  count = 0;                   // time the pin differs from the state [ms]
+  static uint16_t held = 0;                    // time pressed [ms]
+  static uint16_t released = BUTTON_DOUBLE_MS; // time since the last release [ms]
 
   // =====================================================
   // check if button is high or low for the moment
   // =====================================================
-  uint8_t current_state = (bit_is_set(PIN_BUTTON, BIT_BUTTON)) ? 1 : 0;
+  uint8_t current = (bit_is_set(PIN_BUTTON, BIT_BUTTON)) ? FALSE : TRUE;
 
   // =====================================================
-  // button state is about to be changed, increase counter
+  // button state is about to be changed, count the time
   // =====================================================
-  if (current_state != button_state) {
-    count ++;
+  if (current != pressed) {
+
+    // the button has not bounced for BUTTON_DEBOUNCE_MS, change state
+    if (++count >= BUTTON_DEBOUNCE_MS) {
+      pressed = current;
+      count = 0;
 
-    // the button have not bounced for 3 checks, change state
-    if (count >= 4) {
-      button_state = current_state; // we are in a new state
+      if (pressed == TRUE) {
+        put_event(BUTTON_PRESS);
+
+        if (released < BUTTON_DOUBLE_MS)
+          put_event(BUTTON_DOUBLE);
+
+        held = 0;
 
-      // if the button was pressed (not released), tell main so
-      if (current_state == 0) {
-        button_trigger = TRUE;
-        // if button was released again
       } else {
-        if (button_trigger == TRUE)
-          button_down = TRUE;
-      }
+        // short press / long press, a hold is already reported
+        if (held < BUTTON_LONG_MS)
+          put_event(BUTTON_RELEASE);
+        else if (held < BUTTON_HOLD_MS)
+          put_event(BUTTON_LONG);
 
-      count = 0;
+        released = 0;
+      }
     }
 
     // state is similar to old state
   } else {
-    // reset counter
     count = 0;
   }
 
-// =====================================================
-// button state is about to be changed, increase counter
-// =====================================================
-  if (current_state != button_state_long) {
-    count_long ++;
-
-    // the button have not bounced for 3 checks, change state
-    if ((count_long >= 70 && current_state == 0) ||
-        (count_long >= 4 && current_state == 1)) {
-      button_state_long = current_state; // we are in a new state
-
-      // if the button was pressed long (not released), tell main so
-      if (current_state == 0) {
-        button_down_long = TRUE;
-        button_trigger = FALSE;
-      }
-
-      count_long = 0;
-    }
+  // =====================================================
+  // time the button is held / released
+  // =====================================================
+  if (pressed == TRUE) {
+    if (held < BUTTON_HOLD_MS && ++held == BUTTON_HOLD_MS)
+      put_event(BUTTON_HOLD);
 
-    // state is similar to old state
-  } else {
-    // reset counter
-    count_long = 0;
+  } else if (released < BUTTON_DOUBLE_MS) {
+    released++;
   }
 }
 
-uint8_t button_get(void) {
-  if (button_down == TRUE) {
-    button_down = FALSE;
-    return TRUE;
-  }
+ButtonEvent button_get_event(void) {
+  if (queue_tail == queue_head)
+    return BUTTON_NONE;
 
-  return FALSE;
-}
-
-uint8_t button_get_long(void) {
-  if (button_down_long == TRUE) {
-    button_down_long = FALSE;
-    return TRUE;
-  }
+  ButtonEvent event = queue[queue_tail];
+  queue_tail = (queue_tail + 1) & (QUEUE_SIZE - 1);
 
-  return FALSE;
+  return event;
 }
@@ -31,22 +31,31 @@
 */
 extern void button_init(void);
 
-/**
-* @brief read and debounce button
-*
-*/
-extern void button_debounce(void);
+#define BUTTON_DEBOUNCE_MS  20  ///< level has to be stable this long [ms]
+#define BUTTON_LONG_MS      700 ///< held this long is a long press [ms]
+#define BUTTON_HOLD_MS     3000 ///< held this long is a hold [ms]
+#define BUTTON_DOUBLE_MS    300 ///< press again within this time after a release is a double press [ms]
+
+/// \brief button events
+typedef enum {
+  BUTTON_NONE,    ///< no event
+  BUTTON_PRESS,   ///< button pressed (debounced)
+  BUTTON_RELEASE, ///< button released, short press
+  BUTTON_LONG,    ///< button released after BUTTON_LONG_MS
+  BUTTON_HOLD,    ///< button held for BUTTON_HOLD_MS (no release event follows)
+  BUTTON_DOUBLE   ///< press within BUTTON_DOUBLE_MS after a release (after its press event)
+} ButtonEvent;
 
 /**
-* @brief get buttonpress (short)
-* @return TRUE ... button was pressed short / FALSE ... no button press
+* @brief read and debounce button, queue events
+* @note Called every millisecond by the timer interrupt routine
 */
-extern uint8_t button_get(void);
+extern void button_tick(void);
 
 /**
-* @brief get buttonpress (long)
-* @return TRUE.. button was pressed long / FALSE ... no button press
+* @brief get next button event
+* @return ButtonEvent / BUTTON_NONE ... queue is empty
 */
-extern uint8_t button_get_long(void);
+extern ButtonEvent button_get_event(void);
 
 #endif
@@ -28,214 +28,703 @@
 
 #include "enums.h"
 #include "i2c_master.h"
+#include "selector.h"
+#include "timer.h"
 #include "controller.h"
 
 #define CONTROLLER_ADDR (0x52<<1) ///< device address
+#define MAX_FAILS       3         ///< failed reads in a row before slowing down
+#define PROBE_MIN_MS    5         ///< first retry of an empty port
+#define PROBE_MAX_MS    250       ///< slowest retry of an empty port
+#define REQUEST_OLD_MS  32        ///< read request older than any gap, timer_micros() may have wrapped
+
+static Port         cur_port = PORT_A;              ///< selected port
+static ControllerID port_id[NUMBER_PORTS];          ///< detected controller per port
+static I2C_Speed    port_speed[NUMBER_PORTS];       ///< current i2c clock per port
+static uint8_t      port_fails[NUMBER_PORTS];       ///< failed reads in a row
+static I2C_Speed    id_speed[MAX_IDs];              ///< fastest working clock per id
+static uint16_t     port_request[NUMBER_PORTS];     ///< time of the last read request [us]
+static uint16_t     port_request_ms[NUMBER_PORTS];  ///< time of the last read request [ms]
+static uint8_t      port_format[NUMBER_PORTS];      ///< DATA_FORMAT_* per port
+static uint16_t     port_probe_at[NUMBER_PORTS];    ///< next detection of an empty port [ms]
+static uint8_t      port_backoff[NUMBER_PORTS];     ///< current retry interval [ms]
+static uint16_t     port_good_at[NUMBER_PORTS];     ///< time of the last good frame [ms]
+static FrameCheck   port_check[NUMBER_PORTS];       ///< frame check of the bound driver
+static LinkStats    port_stats[NUMBER_PORTS];       ///< link counters per port
+#ifdef CONTROLLER_DECRYPT
+static uint8_t      port_crypt[NUMBER_PORTS];       ///< TRUE ... controller sends encrypted data
+#endif
+
+/// \brief init bytecode of a controller, run by detect_id()
+enum {
+  OP_END,         ///< init done
+  OP_INIT,        ///< 0x55 -> 0xf0, 0x00 -> 0xfb (unencrypted mode)
+  OP_DECRYPT_OFF, ///< encryption handshake with a zero key (CONTROLLER_DECRYPT: 0x00 -> 0x40)
+  OP_IF_WIRED,    ///< [n] run the next n bytes only if the controller sends wired data
+  OP_IF_CHANGED,  ///< [n] read id again, run the next n bytes only if it has changed
+  OP_REDETECT     ///< read id again, match it with the following descriptors
+};
+
+#define INIT_CODE_SIZE  6         ///< bytes of init code per descriptor
+
+#define DESC_HIRES      _BV(0)    ///< supports data format 3
+
+/// \brief everything known about a type of controller
+typedef struct {
+  uint8_t  id[6];                 ///< id pattern (masked)
+  uint8_t  mask[6];               ///< bits of the id to compare
+  uint8_t  code[INIT_CODE_SIZE];  ///< init bytecode
+  uint8_t  flags;                 ///< DESC_*
+  uint16_t gap_us;                ///< time the controller needs after a read request [us]
+  uint8_t  driver;                ///< DriverType to bind
+} Descriptor;
+
+#define EXACT {0xff, 0xff, 0xff, 0xff, 0xff, 0xff} ///< compare the whole id
+#define TYPE  {0x00, 0x00, 0xff, 0xff, 0x00, 0xff} ///< only compare the device type
+
+/// \brief descriptor per ControllerID, first match wins, tune here
+const Descriptor DESCRIPTORS[MAX_IDs] PROGMEM = {
+  // ID_Unknown: not initialized yet
+  {{0xff, 0xff, 0xff, 0xff, 0xff, 0xff}, EXACT,
+   {OP_INIT, OP_REDETECT},
+   0, 500, DRIVER_NONE},
+
+  // ID_Nunchuck
+  {{0x00, 0x00, 0xa4, 0x20, 0x00, 0x00}, EXACT,
+   {OP_END},
+   0, 200, DRIVER_NUNCHUK},
+
+  // ID_Wii_Classic: 8Bitdo SF30 sends wired data, needs init & encryption
+  {{0x00, 0x00, 0xa4, 0x20, 0x01, 0x01}, EXACT,
+   {OP_IF_WIRED, 2, OP_INIT, OP_DECRYPT_OFF},
+   DESC_HIRES, 200, DRIVER_CLASSIC},
+
+  // ID_Wii_Classic_Pro: NES Classic Mini wireless clone sends wired data, needs encryption & init
+  {{0x01, 0x00, 0xa4, 0x20, 0x01, 0x01}, EXACT,
+   {OP_IF_WIRED, 2, OP_DECRYPT_OFF, OP_INIT},
+   DESC_HIRES, 200, DRIVER_CLASSIC},
+
+  // ID_NES_Classic_Mini_Clone_Encrypted
+  {{0x01, 0x00, 0xa4, 0x20, 0x00, 0x01}, EXACT,
+   {OP_DECRYPT_OFF, OP_INIT},
+   DESC_HIRES, 500, DRIVER_CLASSIC},
+
+  // ID_8Bitdo_SF30: Chinese Item# JYS-NS126 has the same id,
+  // but changes it after the encryption and needs no encryption
+  {{0x00, 0x00, 0xa4, 0x20, 0x00, 0x01}, EXACT,
+   {OP_INIT, OP_DECRYPT_OFF, OP_IF_CHANGED, 1, OP_INIT},
+   DESC_HIRES, 500, DRIVER_CLASSIC},
+
+  // ID_Generic_Nunchuk: any other nunchuk like device
+  {{0x00, 0x00, 0xa4, 0x20, 0x00, 0x00}, TYPE,
+   {OP_END},
+   0, 500, DRIVER_NUNCHUK},
+
+  // ID_Generic_Classic: any other classic controller like device
+  {{0x00, 0x00, 0xa4, 0x20, 0x00, 0x01}, TYPE,
+   {OP_IF_WIRED, 2, OP_INIT, OP_DECRYPT_OFF},
+   DESC_HIRES, 500, DRIVER_CLASSIC}
+};
+
+static inline ControllerID timing_id(Port port) {
+  return (port_id[port] < MAX_IDs) ? port_id[port] : ID_Unknown;
+}
+
+void controller_select(Port port) {
+  cur_port = port;
+
+  selector_switch(port);
+  i2c_set_speed(port_speed[port]);
+}
+
+static uint8_t release_bus(uint8_t ret) {
+  // TWI is already disabled after a timeout or bus error
+  if (ret == I2C_ERR_TIMEOUT || ret == I2C_ERR_BUS || ret == I2C_ERR_ARB_LOST)
+    return ret;
+
+  // always release the bus
+  uint8_t stop = i2c_stop();
+
+  return (ret != I2C_OK) ? ret : stop;
+}
+
+static uint8_t write_register(uint8_t reg, uint8_t value, uint8_t count, uint8_t wait) {
+  uint8_t ret;
+
+  if (wait == TRUE)
+    ret = i2c_start_wait(CONTROLLER_ADDR | I2C_WRITE);
+  else
+    ret = i2c_start(CONTROLLER_ADDR | I2C_WRITE);
+
+  if (ret == I2C_OK)
+    ret = i2c_write(reg);
+
+  for (uint8_t i = 0; i < count && ret == I2C_OK; i++)
+    ret = i2c_write(value);
+
+  return release_bus(ret);
+}
+
+static uint8_t unencrypted_mode(void) {
+  uint8_t ret;
 
-void controller_init(void) {
   // --------------------
   // send 0x55 to register 0xf0
-  i2c_start(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0xf0);
-  i2c_write(0x55);
-  i2c_stop();
+  if ((ret = write_register(0xf0, 0x55, 1, FALSE)) != I2C_OK)
+    return ret;
   // --------------------
 
   // --------------------
   // send 0x00 to register 0xfb
-  i2c_start(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0xfb);
-  i2c_write(0x00);
-  i2c_stop();
+  return write_register(0xfb, 0x00, 1, FALSE);
   // --------------------
+}
+
+uint8_t controller_init(void) {
+  uint8_t ret;
+
+  if ((ret = unencrypted_mode()) != I2C_OK)
+    return ret;
 
   // --------------------
   // send 0x00 to register 0xfe
-  i2c_start(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0xfe);
-  i2c_write(0x00);
-  i2c_stop();
+  return write_register(0xfe, 0x00, 1, FALSE);
   // --------------------
 }
 
-static void controller_disable_encryption(void) {
+DriverType controller_driver(ControllerID id) {
+  return (id < MAX_IDs) ? pgm_read_byte(&DESCRIPTORS[id].driver) : DRIVER_NONE;
+}
+
+#ifdef CONTROLLER_DECRYPT
+static void decrypt(uint8_t *data, uint8_t len) {
+  // zero key, every byte: (x ^ 0x17) + 0x17
+  for (uint8_t i = 0; i < len; i++)
+    data[i] = (data[i] ^ 0x17) + 0x17;
+}
+
+#ifdef BENCH
+// decrypt() for bench/bench.c
+void controller_decrypt(uint8_t *data, uint8_t len) {
+  decrypt(data, len);
+}
+#endif
+
+static uint8_t encrypted_mode(void) {
+  // --------------------
+  // send 0x00 to register 0x40 (old init, zero key)
+  return write_register(0x40, 0x00, 1, FALSE);
+  // --------------------
+}
+#else
+static uint8_t controller_disable_encryption(void) {
+  uint8_t ret;
+
   // --------------------
   // send 0xaa to register 0xf0
-  i2c_start_wait(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0xf0);
-  i2c_write(0xaa);
-  i2c_stop();
+  if ((ret = write_register(0xf0, 0xaa, 1, TRUE)) != I2C_OK)
+    return ret;
   // --------------------
 
   // --------------------
   // send 6 zero bytes to register 0x40
-  i2c_start_wait(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0x40);
-
-  for (uint8_t i = 0; i < 6; i++)
-    i2c_write(0x00);
-
-  i2c_stop();
+  if ((ret = write_register(0x40, 0x00, 6, TRUE)) != I2C_OK)
+    return ret;
   // --------------------
 
   // --------------------
   // send 6 zero bytes to register 0x40
-  i2c_start_wait(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0x40);
-
-  for (uint8_t i = 0; i < 6; i++)
-    i2c_write(0x00);
-
-  i2c_stop();
+  if ((ret = write_register(0x40, 0x00, 6, TRUE)) != I2C_OK)
+    return ret;
   // --------------------
 
   // --------------------
   // send 4 zero bytes to register 0x40
-  i2c_start_wait(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0x40);
+  return write_register(0x40, 0x00, 4, TRUE);
+  // --------------------
+}
+#endif
+
+/// \brief phases of a non-blocking controller read
+typedef enum {
+  PHASE_IDLE,     ///< no read in progress
+  PHASE_READ,     ///< reading data bytes and sending the read request
+  PHASE_FAILED    ///< read could not be started
+} ReadPhase;
+
+static ReadPhase read_phase = PHASE_IDLE;
+static ContollerData *read_data;   ///< destination of the running read
+static uint8_t read_error = I2C_OK; ///< I2C_ERR_* of the last failed read
+static uint8_t request_reg = 0x00; ///< register for the next read request
+
+static inline uint8_t frame_size(void) {
+  return (port_format[cur_port] == DATA_FORMAT_HIRES) ? 8 : 6;
+}
 
-  for (uint8_t i = 0; i < 4; i++)
-    i2c_write(0x00);
+static uint8_t frame_valid(const ContollerData *cd) {
+  // floating or confused bus reads all ones
+  for (uint8_t i = 0; i < frame_size(); i++) {
+    if (cd->byte[i] != 0xff) {
+      // impossible data for the bound driver?
+      return (port_check[cur_port] == NULL) ? TRUE : port_check[cur_port](cd);
+    }
+  }
 
-  i2c_stop();
-  // --------------------
+  return FALSE;
 }
 
-uint8_t controller_read(ContollerData *cd) {
+static inline void count(uint16_t *counter) {
+  if (*counter < UINT16_MAX)
+    (*counter) ++;
+}
+
+static void mark_request(void) {
+  port_request[cur_port] = timer_micros();
+  port_request_ms[cur_port] = timer_millis();
+}
+
+static ReadState read_failed(uint8_t error) {
+  read_error = error;
+
+  // retry after the usual gap, the controller prepares a new sample anyway
+  mark_request();
+
   // --------------------
-  // read 6 bytes
-  if (i2c_start(CONTROLLER_ADDR | I2C_READ) != 0) {
-    return FALSE;
+  // no good frame within the hold window, controller is gone
+  // look for a new one right away
+  if ((uint16_t)(timer_millis() - port_good_at[cur_port]) >= CONTROLLER_HOLD_MS) {
+    if (port_id[cur_port] < MAX_IDs)
+      count(&port_stats[cur_port].dropped);
+
+    port_fails[cur_port] = 0;
+    port_backoff[cur_port] = 0;
+    port_probe_at[cur_port] = timer_millis();
+    return READ_FAILED;
   }
+  // --------------------
 
-  uint8_t i = 0;
+  // keep the last good data and try again
+  count(&port_stats[cur_port].retried);
+
+  // slow down this port after some failures in a row,
+  // and remember it for this type of controller
+  if (++port_fails[cur_port] >= MAX_FAILS && port_speed[cur_port] != I2C_SLOWEST) {
+    port_fails[cur_port] = 0;
+    port_speed[cur_port] ++;
+    i2c_set_speed(port_speed[cur_port]);
 
-  for (i = 0; i < 5; i++) {
-    cd->byte[i] = i2c_readAck(); // i2c_read(I2C_ACK);
+    if (port_id[cur_port] < MAX_IDs && id_speed[port_id[cur_port]] < port_speed[cur_port])
+      id_speed[port_id[cur_port]] = port_speed[cur_port];
   }
 
-  cd->byte[i] = (i2c_readNak()); // i2c_read(I2C_NOACK);
-  i2c_stop();
-  // --------------------
+  return READ_SKIPPED;
+}
+
+uint16_t controller_wait(Port port) {
+  uint16_t gap = pgm_read_word(&DESCRIPTORS[timing_id(port)].gap_us);
+  uint16_t elapsed;
+
+  // the us timebase wraps every 65.5 ms, an old request is long done
+  if ((uint16_t)(timer_millis() - port_request_ms[port]) >= REQUEST_OLD_MS)
+    return 0;
+
+  elapsed = timer_micros() - port_request[port];
+
+  return (elapsed >= gap) ? 0 : gap - elapsed;
+}
+
+void controller_request(ContollerData *cd) {
+  read_data = cd;
+
+#ifdef CONTROLLER_HIRES
+  cd->format = port_format[cur_port];
+#endif
 
   // --------------------
-  // send read request to 0x00 register
-  // for the next bytes!!!!
+  // read 6 (8) bytes and send read request to 0x00 register
+  // for the next bytes!!!! in one go, driven by TWI interrupt
   // NOTE this is very important for original Nintendo Controller
-  i2c_start(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0x00);
-  i2c_stop();
+  // NOTE STOP before the read request, no controller is verified with a repeated start
+  if (i2c_async_read_write(CONTROLLER_ADDR | I2C_READ, cd->byte, frame_size(), &request_reg, 1, FALSE) != 0) {
+    read_error = I2C_ERR_BUS;
+    read_phase = PHASE_FAILED;
+    return;
+  }
   // --------------------
 
-  return TRUE;
+  read_phase = PHASE_READ;
+}
+
+ReadState controller_poll(void) {
+  switch (read_phase) {
+    case PHASE_IDLE:
+      return READ_FAILED;
+
+    case PHASE_FAILED:
+      read_phase = PHASE_IDLE;
+      return read_failed(read_error);
+
+    default:
+      break;
+  }
+
+  switch (i2c_async_state()) {
+    case I2C_ASYNC_BUSY:
+      return READ_BUSY;
+
+    case I2C_ASYNC_ERROR:
+      read_phase = PHASE_IDLE;
+      return read_failed(i2c_async_error());
+
+    default:
+      break;
+  }
+
+  read_phase = PHASE_IDLE;
+
+  // next sample is being prepared from now on
+  // NOTE a failing read request doesn't invalidate the data
+  mark_request();
+
+#ifdef CONTROLLER_DECRYPT
+  if (port_crypt[cur_port] == TRUE)
+    decrypt(read_data->byte, frame_size());
+#endif
+
+  if (frame_valid(read_data) == FALSE) {
+    count(&port_stats[cur_port].bad);
+    return read_failed(I2C_ERR_FRAME);
+  }
+
+  port_fails[cur_port] = 0;
+  port_good_at[cur_port] = timer_millis();
+  read_error = I2C_OK;
+
+  return READ_OK;
+}
+
+uint8_t controller_error(void) {
+  return read_error;
+}
+
+void controller_set_check(Port port, FrameCheck check) {
+  port_check[port] = check;
+}
+
+const LinkStats *controller_stats(Port port) {
+  return &port_stats[port];
+}
+
+uint8_t controller_read(ContollerData *cd) {
+  ReadState rs;
+
+  controller_request(cd);
+
+  while ((rs = controller_poll()) == READ_BUSY);
+
+  return (rs == READ_OK) ? I2C_OK : read_error;
 }
 
 
-static void read_id(uint8_t id[6]) {
+static uint8_t read_id(uint8_t id[6]) {
+  uint8_t ret;
+
   // --------------------
   // send read request to 0xfa register
-  i2c_start(CONTROLLER_ADDR | I2C_WRITE);
-  i2c_write(0xFA);
-  i2c_stop();
+  ret = i2c_start(CONTROLLER_ADDR | I2C_WRITE);
+
+  if (ret == I2C_OK)
+    ret = i2c_write(0xFA);
+
+  if ((ret = release_bus(ret)) != I2C_OK)
+    return ret; // if controller is not responsing
   // --------------------
 
   // --------------------
   // read 6 bytes
-  if (i2c_start(CONTROLLER_ADDR | I2C_READ) != 0) {
-    return; // if controller is not responsing
-  }
+  ret = i2c_start(CONTROLLER_ADDR | I2C_READ);
 
   uint8_t i = 0;
 
-  for (i = 0; i < 5; i++) {
-    id[i] = i2c_readAck(); // i2c_read(I2C_ACK);
+  for (i = 0; i < 5 && ret == I2C_OK; i++) {
+    ret = i2c_readAck(&id[i]); // i2c_read(I2C_ACK);
   }
 
-  id[i] = (i2c_readNak()); // i2c_read(I2C_NOACK);
-  i2c_stop();
+  if (ret == I2C_OK)
+    ret = i2c_readNak(&id[i]); // i2c_read(I2C_NOACK);
+
+  ret = release_bus(ret);
   // --------------------
+
+#ifdef CONTROLLER_DECRYPT
+  if (port_crypt[cur_port] == TRUE)
+    decrypt(id, 6);
+#endif
+
+  return ret;
 }
 
-const uint8_t ID_MAP[MAX_IDs][6] PROGMEM = {
-  {0xff, 0xff, 0xff, 0xff, 0xff, 0xff}, // ID_Unknown
-  {0x00, 0x00, 0xa4, 0x20, 0x00, 0x00}, // ID_Nunchuck
-  {0x00, 0x00, 0xa4, 0x20, 0x01, 0x01}, // ID_Wii_Classic
-  {0x01, 0x00, 0xa4, 0x20, 0x01, 0x01}, // ID_Wii_Classic_Pro
-  {0x01, 0x00, 0xa4, 0x20, 0x00, 0x01}, // ID_NES_Classic_Mini_Clone_Encrypted
-  {0x00, 0x00, 0xa4, 0x20, 0x00, 0x01}  // ID_8Bitdo_SF30
-};
+#ifdef CONTROLLER_HIRES
+static uint8_t enable_hires(void) {
+  uint8_t id[6];
+  uint8_t ret;
+
+  // --------------------
+  // send 0x03 to register 0xfe (data format 3)
+  if ((ret = write_register(0xfe, DATA_FORMAT_HIRES, 1, FALSE)) != I2C_OK)
+    return ret;
+  // --------------------
+
+  // --------------------
+  // controller reports its data format in byte 4 of the id
+  if ((ret = read_id(id)) != I2C_OK)
+    return ret;
+
+  if (id[4] == DATA_FORMAT_HIRES) {
+    port_format[cur_port] = DATA_FORMAT_HIRES;
+    return I2C_OK;
+  }
+
+  // not supported, back to the default format
+  return write_register(0xfe, 0x00, 1, FALSE);
+  // --------------------
+}
+#endif
+
+static uint8_t id_matches(const uint8_t id[6], ControllerID desc) {
+  for (uint8_t i = 0; i < 6; i++) {
+    if ((id[i] & pgm_read_byte(&DESCRIPTORS[desc].mask[i])) != pgm_read_byte(&DESCRIPTORS[desc].id[i]))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+// one frame for detection, without the link layer:
+// no frame check, no stats, no backoff and no clock downshift
+static uint8_t read_raw(ContollerData *cd) {
+  I2C_AsyncState state;
+
+#ifdef CONTROLLER_HIRES
+  cd->format = port_format[cur_port];
+#endif
+
+  if (i2c_async_read_write(CONTROLLER_ADDR | I2C_READ, cd->byte, frame_size(), &request_reg, 1, FALSE) != 0)
+    return I2C_ERR_BUS;
+
+  while ((state = i2c_async_state()) == I2C_ASYNC_BUSY);
+
+  mark_request();
+
+  if (state == I2C_ASYNC_ERROR)
+    return i2c_async_error();
+
+#ifdef CONTROLLER_DECRYPT
+  if (port_crypt[cur_port] == TRUE)
+    decrypt(cd->byte, frame_size());
+#endif
+
+  return I2C_OK;
+}
+
+static uint8_t sends_wired_data(uint8_t *wired) {
+  ContollerData data;
+  uint8_t ret;
+
+  // wireless clones send zeros in the button bytes
+  // while they are still in wired mode
+  ret = read_raw(&data);
+  *wired = (data.byte[4] == 0x00 && data.byte[5] == 0x00) ? TRUE : FALSE;
+
+  return ret;
+}
+
+static uint8_t set_format(ControllerID desc, uint8_t init) {
+#ifdef CONTROLLER_HIRES
+  // classic controllers: try full 8 bit analog format
+  if (pgm_read_byte(&DESCRIPTORS[desc].flags) & DESC_HIRES)
+    return enable_hires();
+#endif
+
+  // --------------------
+  // send 0x00 to register 0xfe after an init
+  if (init == TRUE)
+    return write_register(0xfe, 0x00, 1, FALSE);
+  // --------------------
+
+  return I2C_OK;
+}
 
-ControllerID get_id(void) {
+static uint8_t detect_id(ControllerID *found) {
   uint8_t id[6];
+  uint8_t ret;
+  uint8_t init = FALSE; // unencrypted mode sent, data format has to be set
 
-  memset(id, 0, 6);
-  read_id(id);
-
-  // --------------------
-  // compare the 6 bytes with known IDs
-  for (uint8_t i = 0; i < MAX_IDs; i++) {
-
-    // known controller found?
-    if (memcmp_P(&id[0], &ID_MAP[i][0], 6) == 0) {
-
-      switch (i) {
-        case ID_Unknown:
-          controller_init();
-          read_id(id); // update id
-          continue;
-
-        case ID_Wii_Classic: {
-          ContollerData data;
-          controller_read(&data);
-
-          // look if controller sends wired data (8Bitdo_SF30)
-          // needs init & encryption afterwards
-          if (data.byte[4] == 0x00 && data.byte[5] == 0x00) {
-            controller_init();
-            controller_disable_encryption();
-          }
-        }
-        break;
-
-        case ID_Wii_Classic_Pro: {
-          ContollerData data;
-          controller_read(&data);
-
-          // look if controller sends wired data
-          // NES Classic Mini Wireless Clone needs encryption & init afterwards
-          if (data.byte[4] == 0x00 && data.byte[5] == 0x00) {
-            controller_disable_encryption();
-            controller_init();
-          }
-        }
-        break;
-
-        case ID_NES_Classic_Mini_Clone_Encrypted:
-          controller_disable_encryption();
-          controller_init();
+  *found = MAX_IDs; // no known controller found
+
+  if ((ret = read_id(id)) != I2C_OK)
+    return ret;
+
+  // --------------------
+  // first descriptor matching the id
+  for (ControllerID desc = 0; desc < MAX_IDs; desc++) {
+
+    if (id_matches(id, desc) == FALSE)
+      continue;
+
+    // --------------------
+    // run the init code
+    const uint8_t *pc = DESCRIPTORS[desc].code;
+    const uint8_t *end = pc + INIT_CODE_SIZE;
+    uint8_t redetect = FALSE;
+
+    while (pc < end && redetect == FALSE) {
+      uint8_t op = pgm_read_byte(pc++);
+      uint8_t run = TRUE;
+
+      switch (op) {
+        case OP_INIT:
+          ret = unencrypted_mode();
+          init = TRUE;
+#ifdef CONTROLLER_DECRYPT
+          port_crypt[cur_port] = FALSE;
+#endif
           break;
 
-        case ID_8Bitdo_SF30:
-          controller_init();
-          controller_disable_encryption();
+        case OP_DECRYPT_OFF:
+#ifdef CONTROLLER_DECRYPT
+          // stay encrypted, one write instead of the handshake
+          ret = encrypted_mode();
+          port_crypt[cur_port] = TRUE;
+#else
+          ret = controller_disable_encryption();
+#endif
+          break;
 
-          read_id(id);
+        case OP_IF_WIRED:
+          ret = sends_wired_data(&run);
+          break;
 
-          // if controller id has changed, then it is not a ID_8Bitdo_SF30
-          // Chinese Item# JYS-NS126 has also same ID, but doesn't need encryption
-          if (memcmp_P(&id[0], &ID_MAP[i][0], 6) != 0) {
-            controller_init();
-          }
+        case OP_IF_CHANGED:
+          ret = read_id(id);
+          run = (id_matches(id, desc) == TRUE) ? FALSE : TRUE;
+          break;
+
+        case OP_REDETECT:
+          ret = read_id(id);
+          redetect = TRUE;
+          break;
 
+        default: // OP_END
+          pc = end;
           break;
+      }
+
+      if (ret != I2C_OK)
+        return ret;
+
+      // conditional: skip the following n bytes
+      if (op == OP_IF_WIRED || op == OP_IF_CHANGED) {
+        uint8_t skip = pgm_read_byte(pc++);
+
+        if (run == FALSE)
+          pc += skip;
+      }
+    }
+
+    // id has changed, go on with the following descriptors
+    if (redetect == TRUE)
+      continue;
+    // --------------------
+
+    if ((ret = set_format(desc, init)) == I2C_OK)
+      *found = desc;
+
+    return ret;
+  }
+
+  // --------------------
+
+  return I2C_OK;
+}
+
+uint8_t controller_probe_due(Port port) {
+  return ((int16_t)(timer_millis() - port_probe_at[port]) >= 0) ? TRUE : FALSE;
+}
+
+static void probe_later(void) {
+  // double the interval: 5, 10, 20, ... 250 ms
+  if (port_backoff[cur_port] < PROBE_MIN_MS)
+    port_backoff[cur_port] = PROBE_MIN_MS;
+  else if (port_backoff[cur_port] < PROBE_MAX_MS / 2)
+    port_backoff[cur_port] *= 2;
+  else
+    port_backoff[cur_port] = PROBE_MAX_MS;
+
+  port_probe_at[cur_port] = timer_millis() + port_backoff[cur_port];
+}
+
+static uint8_t probe(void) {
+  // --------------------
+  // only address the controller, any clone can do 50 kHz
+  i2c_set_speed(I2C_SLOWEST);
+
+  return release_bus(i2c_start(CONTROLLER_ADDR | I2C_WRITE));
+  // --------------------
+}
 
-      } // switch
+uint8_t get_id(ControllerID *id) {
+  uint8_t ret;
 
-      return i;
+  *id = MAX_IDs; // no known controller found
+  port_id[cur_port] = MAX_IDs;
+  port_speed[cur_port] = I2C_FASTEST;
+  port_fails[cur_port] = 0;
+  port_format[cur_port] = DATA_FORMAT_STD;
+  port_check[cur_port] = NULL; // until a driver is bound
+#ifdef CONTROLLER_DECRYPT
+  port_crypt[cur_port] = FALSE;
+#endif
+
+  // --------------------
+  // cheap check first, is anybody there?
+  if ((ret = probe()) != I2C_OK) {
+    probe_later();
+    return ret;
+  }
+
+  // --------------------
+  // try the fastest clock first
+  for (I2C_Speed speed = I2C_FASTEST; speed < I2C_NUMBER_SPEEDS; speed++) {
+    i2c_set_speed(speed);
+
+    ret = detect_id(id);
+
+    // stuck bus, don't waste more time on this port
+    if (ret == I2C_ERR_TIMEOUT || ret == I2C_ERR_BUS)
+      break;
+
+    if (*id != MAX_IDs) {
+      // don't go faster than this type of controller managed before
+      if (speed < id_speed[*id])
+        speed = id_speed[*id];
+
+      port_id[cur_port] = *id;
+      port_speed[cur_port] = speed;
+      i2c_set_speed(speed);
+      mark_request();
+      port_good_at[cur_port] = timer_millis();
+      port_backoff[cur_port] = 0;
+
+      return I2C_OK;
     }
   }
 
   // --------------------
+  // unknown controller, try again later
+
+  *id = MAX_IDs;
+  probe_later();
 
-  return MAX_IDs; // no known controller found, return MAX_IDs
+  return ret;
 }
@@ -25,9 +25,25 @@
 
 #include <stdint.h>
 
-/// \brief 6 bytes of controller data
+#include "enums.h"
+
+#define DATA_FORMAT_STD    1 ///< 6 data bytes (default)
+#define DATA_FORMAT_HIRES  3 ///< 8 data bytes, full 8 bit analog (classic only)
+
+#define I2C_ERR_FRAME      6 ///< frame read fine but rejected by the frame check (after I2C_ERR_*)
+
+#ifdef CONTROLLER_HIRES
+#define CONTROLLER_DATA_SIZE  8
+#else
+#define CONTROLLER_DATA_SIZE  6
+#endif
+
+/// \brief 6 (or 8) bytes of controller data
 typedef struct {
-  uint8_t byte[6];  ///< 6 data bytes
+  uint8_t byte[CONTROLLER_DATA_SIZE];  ///< data bytes
+#ifdef CONTROLLER_HIRES
+  uint8_t format;                      ///< DATA_FORMAT_STD / DATA_FORMAT_HIRES
+#endif
 } ContollerData;
 
 /// \brief enumeration of different controller IDs
@@ -39,28 +55,165 @@ typedef enum {
   ID_NES_Classic_Mini_Clone_Encrypted,  ///< 4 NES Classic Mini Clone encrypted
   ID_8Bitdo_SF30,                       ///< 5 8Bitdo SF30
   // room for new IDs
+  ID_Generic_Nunchuk,                   ///< 6 other nunchuk like device
+  ID_Generic_Classic,                   ///< 7 other classic controller like device
   MAX_IDs           ///< number of different supported ids
 } ControllerID;
 
+/// \brief driver a controller type is bound to
+typedef enum {
+  DRIVER_NONE,    ///< no driver, not usable
+  DRIVER_NUNCHUK, ///< nunchuk driver
+  DRIVER_CLASSIC, ///< classic controller driver
+
+  NUMBER_DRIVERS  ///< number of different drivers
+} DriverType;
+
+/**
+* @brief driver check of a received frame
+* @param cd controller data
+* @return TRUE ... possible data / FALSE ... impossible data, read again
+*/
+typedef uint8_t (*FrameCheck)(const ContollerData *cd);
+
+/// \brief link counters of a port
+typedef struct {
+  uint16_t bad;     ///< frames rejected by the frame checks
+  uint16_t retried; ///< failed reads, which kept the last good data
+  uint16_t dropped; ///< controllers lost after the hold window
+} LinkStats;
+
+#ifndef CONTROLLER_HOLD_MS
+#define CONTROLLER_HOLD_MS 60 ///< keep the last good data this long before giving up [ms]
+#endif
+
+/// \brief state of a non-blocking controller read
+typedef enum {
+  READ_BUSY,    ///< transfer still running
+  READ_OK,      ///< data is valid
+  READ_SKIPPED, ///< no new data, try again (keep old data)
+  READ_FAILED   ///< no good data within CONTROLLER_HOLD_MS
+} ReadState;
+
+/**
+* @brief select the i2c port of a controller
+*
+* Switches the i2c selector and the i2c clock of the port.
+* Only call while no read is in progress.
+*
+* @param port PORT_A or PORT_B
+*/
+extern void controller_select(Port port);
+
 /**
 * @brief send init sequence to controller
 *
+* @return I2C_OK / I2C_ERR_* ... if controller doesn't respond
 */
-extern void controller_init(void);
+extern uint8_t controller_init(void);
+
+/**
+* @brief driver to bind to a type of controller
+*
+* @param id enum ControllerID / MAX_IDs
+* @return DRIVER_* / DRIVER_NONE ... if there is no driver
+*/
+extern DriverType controller_driver(ControllerID id);
 
 /**
 * @brief read current controller data
 *
-* @param [out] cd a struct of 6 bytes to store data of the controller
-* @return TRUE ... if read was ok / FALSE ... if read error
+* @param [out] cd a struct to store data of the controller
+* @return I2C_OK ... if read was ok / I2C_ERR_* ... if read error /
+*         I2C_ERR_FRAME ... if the frame was rejected
 */
 extern uint8_t controller_read(ContollerData *cd);
 
+/**
+* @brief time until the controller on a port has a new sample ready
+*
+* Each controller type needs some time between the read request
+* (sent with every read) and the next read. The port doesn't need
+* to be selected, so the other port can be served in the meantime.
+*
+* @param port PORT_A or PORT_B
+* @return 0 ... ready to read / else ... still preparing [us]
+*/
+extern uint16_t controller_wait(Port port);
+
+/**
+* @brief start a non-blocking read of the controller data
+*
+* Reads 6 (or 8) bytes and sends the read request for the next sample in
+* one transaction. The transfer runs in the background (TWI interrupt), the
+* selected port must not be changed until controller_poll()
+* doesn't return READ_BUSY anymore.
+*
+* @param [out] cd a struct to store data of the controller
+*/
+extern void controller_request(ContollerData *cd);
+
+/**
+* @brief poll a read started with controller_request()
+*
+* Failed reads are retried on the next request, after repeated
+* failures the i2c clock of the port is lowered step by step.
+*
+* @return READ_BUSY ... transfer running / READ_OK ... data valid /
+*         READ_SKIPPED ... no new data / READ_FAILED ... controller lost
+*/
+extern ReadState controller_poll(void);
+
+/**
+* @brief reason of the last failed read
+*
+* @return I2C_OK / I2C_ERR_* (see i2c_master.h) / I2C_ERR_FRAME
+*/
+extern uint8_t controller_error(void);
+
+/**
+* @brief set the frame check of the driver bound to a port
+*
+* All ones frames are always rejected. get_id() clears the check.
+*
+* @param port PORT_A or PORT_B
+* @param check driver check / NULL ... no check
+*/
+extern void controller_set_check(Port port, FrameCheck check);
+
+/**
+* @brief link counters of a port
+*
+* @param port PORT_A or PORT_B
+* @return counters, saturate at UINT16_MAX
+*/
+extern const LinkStats *controller_stats(Port port);
+
+/**
+* @brief is it time to look for a controller on a port?
+*
+* Empty ports and unknown controllers are retried with exponential
+* backoff (5 ms ... 250 ms) so they don't slow down the other port.
+*
+* @param port PORT_A or PORT_B
+* @return TRUE ... call get_id() / FALSE ... skip the port
+*/
+extern uint8_t controller_probe_due(Port port);
+
 /**
 * @brief get controller id
 *
-* @return enum ControllerID / MAX_IDs ... if id not found
+* Starts with a single address probe, the full detection only runs
+* if a controller acknowledges. The id is matched against a table of
+* controller descriptors, whose init code is run afterwards. Similar
+* ids fall back to a generic nunchuk or classic controller.
+*
+* Tries the fastest i2c clock first and keeps the fastest working
+* one for the selected port.
+*
+* @param [out] id enum ControllerID / MAX_IDs ... if id not found
+* @return I2C_OK / I2C_ERR_* ... if port doesn't respond
 */
-extern ControllerID get_id(void);
+extern uint8_t get_id(ControllerID *id);
 
 #endif
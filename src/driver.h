@@ -57,6 +57,13 @@ typedef struct {
   */
   uint8_t (*get_paddle_enabled)(void);
 
+  /**
+  * @brief check a received frame for impossible data
+  * @param [in] cd controller data
+  * @return TRUE ... possible data / FALSE ... impossible data
+  */
+  FrameCheck frame_valid;
+
 } Driver;
 
 #endif
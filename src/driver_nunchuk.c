@@ -110,14 +110,11 @@ static void get_joystick_state_nunchuk(const ContollerData *cd, Joystick *joysti
     break;
 
     case LED_BLINK1:
-    case LED_BLINK2: {
+    case LED_BLINK2:
+    case LED_BLINK3: {
     }
     break;
 
-//     case LED_BLINK3: {
-//     }
-//     break;
-
     case NUMBER_LED_STATES: {
     }
     break;
@@ -128,9 +125,9 @@ static void get_joystick_state_nunchuk(const ContollerData *cd, Joystick *joysti
     (*joystick) |= BUTTON;
   }
 
-  // C Button
+  // C Button (1351 mouse: right button)
   if ((cd->byte[5] & 0x02) == 0) {
-    (*joystick) |= AUTOFIRE;
+    (*joystick) |= (led_get_state() == LED_BLINK3) ? UP : AUTOFIRE;
   }
 }
 
@@ -148,7 +145,8 @@ static void get_paddle_state_nunchuk(const ContollerData *cd, Paddle *paddle) {
     paddle->axis_x = x;
     paddle->axis_y = y;
 
-  } else if (led_get_state() == LED_BLINK2) {
+  } else if (led_get_state() == LED_BLINK2 ||
+             led_get_state() == LED_BLINK3) {
 
     int16_t x = cd->byte[0] << 2;
     int16_t y = cd->byte[1] << 2;
@@ -165,6 +163,7 @@ uint8_t get_paddle_enabled_nunchuk(void) {
   switch (led_get_state()) {
     case LED_BLINK1:
     case LED_BLINK2:
+    case LED_BLINK3:
       return TRUE;
 
     default:
@@ -172,8 +171,19 @@ uint8_t get_paddle_enabled_nunchuk(void) {
   }
 }
 
+static uint8_t frame_valid_nunchuk(const ContollerData *cd) {
+  // stick and accelerometer can't be at zero together
+  for (uint8_t i = 0; i < 6; i++) {
+    if (cd->byte[i] != 0x00)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
 Driver drv_nunchuk = {
   get_joystick_state_nunchuk,
   get_paddle_state_nunchuk,
-  get_paddle_enabled_nunchuk
+  get_paddle_enabled_nunchuk,
+  frame_valid_nunchuk
 };
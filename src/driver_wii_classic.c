@@ -40,7 +40,8 @@ const uint16_t button_map[NUMBER_LED_STATES][NUMBER_BUTTONS] PROGMEM = {
   { UP,         BUTTON,     BUTTON2,    AUTOFIRE,   SPACE,      BUTTON,     BUTTON2 },  // LED OFF
   { BUTTON2,    BUTTON,     BUTTON3,    UP,         SPACE,      BUTTON,     BUTTON2 },  // LED ON
   { UP,         DOWN,       BUTTON,     AUTOFIRE,   SPACE,      BUTTON,     BUTTON2 },  // LED F1 (zschunky Mode)
-  { RIGHT,      LEFT,       BUTTON,     0,          SPACE,      BUTTON,     0       }   // LED F2
+  { RIGHT,      LEFT,       BUTTON,     0,          SPACE,      BUTTON,     0       },  // LED F2
+  { BUTTON,     UP,         BUTTON,     UP,         SPACE,      BUTTON,     0       }   // LED F3 (1351 mouse)
 };
 
 static inline uint16_t map_buttons(Button btn) {
@@ -58,115 +59,149 @@ const uint16_t dpad_map[NUMBER_LED_STATES][NUMBER_BUTTONS] PROGMEM = {
   { UP,     DOWN,   LEFT,   RIGHT,  LEFT,   RIGHT   },  // LED OFF
   { UP,     DOWN,   LEFT,   RIGHT,  LEFT,   RIGHT   },  // LED ON
   { 0,      0,      LEFT,   RIGHT,  BUTTON, BUTTON  },  // LED F1 (zschunky Mode)
-  { 0,      0,      0,      0,      0,      0       }   // LED F2
+  { 0,      0,      0,      0,      0,      0       },  // LED F2
+  { 0,      0,      0,      0,      BUTTON, UP      }   // LED F3 (1351 mouse)
 };
 
 static inline uint16_t map_dpad(DPads dpad) {
   return pgm_read_word(&dpad_map[led_get_state()][dpad]);
 }
 
+#ifdef CONTROLLER_HIRES
+static inline uint8_t hires(const ContollerData *cd) {
+  return (cd->format == DATA_FORMAT_HIRES);
+}
+#else
+#define hires(cd) 0
+#endif
+
+// data format 1: buttons in byte 4 & 5 / data format 3: buttons in byte 6 & 7
+static inline uint8_t buttons(const ContollerData *cd, uint8_t n) {
+  return hires(cd) ? cd->byte[6 + n] : cd->byte[4 + n];
+}
+
+// 8 bit, only meaningful in data format 3
+static inline uint8_t left_x8(const ContollerData *cd) {
+  return cd->byte[0];
+}
+
+static inline uint8_t left_y8(const ContollerData *cd) {
+  return cd->byte[2];
+}
+
 static inline uint8_t left_x(const ContollerData *cd) {
-  return (cd->byte[0] & 0x3f);
+  return hires(cd) ? (left_x8(cd) >> 2) : (cd->byte[0] & 0x3f);
 }
 
 static inline uint8_t left_y(const ContollerData *cd) {
-  return (cd->byte[1] & 0x3f);
+  return hires(cd) ? (left_y8(cd) >> 2) : (cd->byte[1] & 0x3f);
 }
 
 static inline uint8_t analog_rt(const ContollerData *cd) {
-  return (cd->byte[3] & 0x1f);
+  return hires(cd) ? (cd->byte[5] >> 3) : (cd->byte[3] & 0x1f);
 }
 
 static inline uint8_t analog_lt(const ContollerData *cd) {
-  return (((cd->byte[2] & 0x60) >> 2) + ((cd->byte[3] & 0xe0) >> 5));
+  return hires(cd) ? (cd->byte[4] >> 3) :
+         (((cd->byte[2] & 0x60) >> 2) + ((cd->byte[3] & 0xe0) >> 5));
 }
 
 static void get_joystick_state_wii_classic(const ContollerData *cd, Joystick *joystick) {
 
   // see: http://wiibrew.org/wiki/Wiimote/Extension_Controllers/Classic_Controller
 
+  uint8_t b4 = buttons(cd, 0);
+  uint8_t b5 = buttons(cd, 1);
+
   (*joystick) = 0;
 
   // BDU - DPAD U
-  if ((cd->byte[5] & 0x01) == 0) {
+  if ((b5 & 0x01) == 0) {
     (*joystick) |= map_dpad(D_UP);
   }
 
   // BDD - DPAD D
-  if ((cd->byte[4] & 0x40) == 0) {
+  if ((b4 & 0x40) == 0) {
     (*joystick) |= map_dpad(D_DOWN);
   }
 
   // BDL - DPAD L
-  if ((cd->byte[5] & 0x02) == 0) {
+  if ((b5 & 0x02) == 0) {
     (*joystick) |= map_dpad(D_LEFT);
   }
 
   // BDR - DPAD R
-  if ((cd->byte[4] & 0x80) == 0) {
+  if ((b4 & 0x80) == 0) {
     (*joystick) |= map_dpad(D_RIGHT);
   }
 
   // ------------------------------
 
   // BA - A Button
-  if ((cd->byte[5] & 0x10) == 0) {
+  if ((b5 & 0x10) == 0) {
     (*joystick) |= map_buttons(A);
   }
 
   // BB - B Button
-  if ((cd->byte[5] & 0x40) == 0) {
+  if ((b5 & 0x40) == 0) {
     (*joystick) |= map_buttons(B);
   }
 
   // BX - X Button
-  if ((cd->byte[5] & 0x08) == 0) {
+  if ((b5 & 0x08) == 0) {
     (*joystick) |= map_buttons(X);
   }
 
   // BY - Y Button
-  if ((cd->byte[5] & 0x20) == 0) {
+  if ((b5 & 0x20) == 0) {
     (*joystick) |= map_buttons(Y);
   }
 
   // ------------------------------
 
   // BLT - Button left (trigger)
-  if ((cd->byte[4] & 0x20) == 0) {
+  if ((b4 & 0x20) == 0) {
     (*joystick) |= map_dpad(D_TL);
   }
 
   // BRT - Button right (trigger)
-  if ((cd->byte[4] & 0x02) == 0) {
+  if ((b4 & 0x02) == 0) {
     (*joystick) |= map_dpad(D_TR);
   }
 
   // ------------------------------
 
   // LT - Button left (trigger)
-  if ((cd->byte[4] & 0x20) == 0) {
+  if ((b4 & 0x20) == 0) {
     (*joystick) |= map_dpad(D_TL);
   }
 
   // RT - Button right (trigger)
-  if ((cd->byte[4] & 0x02) == 0) {
+  if ((b4 & 0x02) == 0) {
     (*joystick) |= map_dpad(D_TR);
   }
 
   // ------------------------------
 
+  // BZL - Button ZL
+  if ((b5 & 0x80) == 0) {
+    (*joystick) |= AUTOFIRE_RATE;
+  }
+
+  // ------------------------------
+
   // B+ - Button Start
-  if ((cd->byte[4] & 0x04) == 0) {
+  if ((b4 & 0x04) == 0) {
     (*joystick) |= map_buttons(START);
   }
 
   // Home - Button Start
-  if ((cd->byte[4] & 0x08) == 0) {
+  if ((b4 & 0x08) == 0) {
     (*joystick) |= map_buttons(HOME);
   }
 
   // B- - Button Select
-  if ((cd->byte[4] & 0x10) == 0) {
+  if ((b4 & 0x10) == 0) {
     (*joystick) |= map_buttons(SELECT);
   }
 
@@ -208,10 +243,21 @@ static void get_joystick_state_wii_classic(const ContollerData *cd, Joystick *jo
 static void get_paddle_state_wii_classic(const ContollerData *cd, Paddle *paddle) {
 
   if (led_get_state() == LED_BLINK1 ||
-      led_get_state() == LED_BLINK2) {
-
-    int16_t x = left_x(cd) << 4;
-    int16_t y = left_y(cd) << 4;
+      led_get_state() == LED_BLINK2 ||
+      led_get_state() == LED_BLINK3) {
+
+    int16_t x;
+    int16_t y;
+
+    if (hires(cd)) {
+      // 256 steps
+      x = left_x8(cd) << 2;
+      y = left_y8(cd) << 2;
+    } else {
+      // 64 steps
+      x = left_x(cd) << 4;
+      y = left_y(cd) << 4;
+    }
 
     // x = scale(x, 1.6);
     // y = scale(y, 1.6);
@@ -224,6 +270,7 @@ static void get_paddle_state_wii_classic(const ContollerData *cd, Paddle *paddle
 uint8_t get_paddle_enabled_wii_classic(void) {
   switch (led_get_state()) {
     case LED_BLINK2:
+    case LED_BLINK3:
       return TRUE;
 
     default:
@@ -231,8 +278,24 @@ uint8_t get_paddle_enabled_wii_classic(void) {
   }
 }
 
+static uint8_t frame_valid_wii_classic(const ContollerData *cd) {
+  uint8_t b4 = buttons(cd, 0);
+  uint8_t b5 = buttons(cd, 1);
+
+  // a d pad can't be pressed up & down (BDU, BDD) ...
+  if ((b5 & 0x01) == 0 && (b4 & 0x40) == 0)
+    return FALSE;
+
+  // ... or left & right (BDL, BDR), this also rejects all zeros
+  if ((b5 & 0x02) == 0 && (b4 & 0x80) == 0)
+    return FALSE;
+
+  return TRUE;
+}
+
 Driver drv_wii_classic = {
   get_joystick_state_wii_classic,
   get_paddle_state_wii_classic,
-  get_paddle_enabled_wii_classic
+  get_paddle_enabled_wii_classic,
+  frame_valid_wii_classic
 };
@@ -8,8 +8,13 @@
 **************************************************************************/
 #include <inttypes.h>
 #include <compat/twi.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/delay.h>
 
 #include "i2c_master.h"
+#include "ioconfig.h"
+#include "timer.h"
 
 
 /* define CPU frequency in Mhz here if not defined in Makefile */
@@ -17,102 +22,185 @@
 // #define F_CPU 4000000UL
 // #endif
 
-/* I2C clock in Hz */
-#define SCL_CLOCK  50000L
+/* busy wait budget for one byte, ~8 cycles per loop */
+#define I2C_TIMEOUT_LOOPS  ((F_CPU / 1000000L) * I2C_TIMEOUT_US / 8)
+
+/* set on timeout or bus error, see i2c_get_fault() */
+static volatile uint8_t i2c_fault = 0;
+
+/* half SCL period of the recovery clock (100 kHz) */
+#define I2C_RECOVER_HALF_US  5
+
+/* interrupt driven transaction engine, see i2c_async_start() */
+static volatile uint8_t          async_addr;               ///< address and direction
+static unsigned char * volatile  async_buf;                ///< data buffer
+static volatile uint8_t          async_len;                ///< number of data bytes
+static volatile uint8_t          async_idx;                ///< current data byte
+static volatile I2C_AsyncState   async_state = I2C_ASYNC_IDLE;
+static volatile uint8_t          async_error;              ///< I2C_ERR_* of last transaction
+static uint16_t                  async_time;               ///< start time in ms
+static unsigned char * volatile  async_tx;                 ///< follow-up write after a read
+static volatile uint8_t          async_tx_len;             ///< bytes of the follow-up write
+static volatile uint8_t          async_tx_start;           ///< TWCR bits to start the write
+static volatile uint8_t          async_in_tx;              ///< read done, follow-up write running
+
+/* TWBR value for a I2C clock in Hz, TWPS = 0 => prescaler = 1 */
+#define TWBR_VALUE(scl)  (((F_CPU / (scl)) - 16) / 2)
+
+/* bit rate register values, indexed by I2C_Speed */
+static const uint8_t TWBR_MAP[I2C_NUMBER_SPEEDS] = {
+  TWBR_VALUE(400000L), /* I2C_400KHZ */
+  TWBR_VALUE(200000L), /* I2C_200KHZ */
+  TWBR_VALUE(100000L), /* I2C_100KHZ */
+  TWBR_VALUE(50000L)   /* I2C_50KHZ  */
+};
 
 /*************************************************************************
  Initialization of the I2C bus interface. Need to be called only once
 *************************************************************************/
 void i2c_init(void) {
-  /* initialize TWI clock: 100 kHz clock, TWPS = 0 => prescaler = 1 */
+  /* initialize TWI clock: 50 kHz clock, TWPS = 0 => prescaler = 1 */
 
   TWSR = 0;                         /* no prescaler */
-  TWBR = ((F_CPU / SCL_CLOCK) - 16) / 2; /* must be > 10 for stable operation */
+  i2c_set_speed(I2C_50KHZ);
 
 }/* i2c_init */
 
 
+/*************************************************************************
+ Change the I2C clock, only call while the bus is idle
+
+ Input:   one of I2C_Speed
+*************************************************************************/
+void i2c_set_speed(I2C_Speed speed) {
+  if (speed >= I2C_NUMBER_SPEEDS) speed = I2C_SLOWEST;
+
+  TWBR = TWBR_MAP[speed];
+
+}/* i2c_set_speed */
+
+
+/*************************************************************************
+ Release the bus after a timeout or bus error, remember the fault
+*************************************************************************/
+static unsigned char i2c_abort(unsigned char error) {
+  TWCR = 0;           /* disable TWI, SDA/SCL are released */
+  i2c_fault = 1;
+
+  return error;
+
+}/* i2c_abort */
+
+
+/*************************************************************************
+ Wait for TWINT with a timeout
+
+ Return:  I2C_OK or I2C_ERR_TIMEOUT
+*************************************************************************/
+static unsigned char i2c_wait(void) {
+  uint16_t budget = I2C_TIMEOUT_LOOPS;
+
+  while (!(TWCR & (1 << TWINT))) {
+    if (--budget == 0) return i2c_abort(I2C_ERR_TIMEOUT);
+  }
+
+  return I2C_OK;
+
+}/* i2c_wait */
+
+
+/*************************************************************************
+ Wait until a stop condition is executed and the bus is released
+
+ Return:  I2C_OK or I2C_ERR_TIMEOUT
+*************************************************************************/
+static unsigned char i2c_wait_stop(void) {
+  uint16_t budget = I2C_TIMEOUT_LOOPS;
+
+  while (TWCR & (1 << TWSTO)) {
+    if (--budget == 0) return i2c_abort(I2C_ERR_TIMEOUT);
+  }
+
+  return I2C_OK;
+
+}/* i2c_wait_stop */
+
+
+/*************************************************************************
+ Translate an unexpected TWI status into an error code
+*************************************************************************/
+static unsigned char i2c_error(uint8_t twst) {
+  switch (twst) {
+    case TW_MT_ARB_LOST:  return I2C_ERR_ARB_LOST;  /* = TW_MR_ARB_LOST */
+    case TW_MT_SLA_NACK:
+    case TW_MR_SLA_NACK:  return I2C_ERR_SLA_NACK;
+    case TW_MT_DATA_NACK: return I2C_ERR_DATA_NACK;
+    default:              return i2c_abort(I2C_ERR_BUS);
+  }
+
+}/* i2c_error */
+
+
 /*************************************************************************
   Issues a start condition and sends address and transfer direction.
-  return 0 = device accessible, 1= failed to access device
+  return I2C_OK = device accessible, else one of the I2C_ERR_* codes
 *************************************************************************/
 unsigned char i2c_start(unsigned char address) {
   uint8_t   twst;
 
+  // previous stop condition must be executed
+  if (i2c_wait_stop() != I2C_OK) return I2C_ERR_TIMEOUT;
+
   // send START condition
   TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
 
   // wait until transmission completed
-  while (!(TWCR & (1 << TWINT)));
+  if (i2c_wait() != I2C_OK) return I2C_ERR_TIMEOUT;
 
   // check value of TWI Status Register. Mask prescaler bits.
   twst = TW_STATUS & 0xF8;
 
-  if ((twst != TW_START) && (twst != TW_REP_START)) return 1;
+  if ((twst != TW_START) && (twst != TW_REP_START)) return i2c_error(twst);
 
   // send device address
   TWDR = address;
   TWCR = (1 << TWINT) | (1 << TWEN);
 
   // wail until transmission completed and ACK/NACK has been received
-  while (!(TWCR & (1 << TWINT)));
+  if (i2c_wait() != I2C_OK) return I2C_ERR_TIMEOUT;
 
   // check value of TWI Status Register. Mask prescaler bits.
   twst = TW_STATUS & 0xF8;
 
-  if ((twst != TW_MT_SLA_ACK) && (twst != TW_MR_SLA_ACK)) return 1;
+  if ((twst != TW_MT_SLA_ACK) && (twst != TW_MR_SLA_ACK)) return i2c_error(twst);
 
-  return 0;
+  return I2C_OK;
 
 }/* i2c_start */
 
 
 /*************************************************************************
  Issues a start condition and sends address and transfer direction.
- If device is busy, use ack polling to wait until device is ready
+ If device is busy, use ack polling to wait until device is ready,
+ but not more than I2C_START_RETRIES times
 
  Input:   address and transfer direction of I2C device
+ Return:  I2C_OK = device accessible, else one of the I2C_ERR_* codes
 *************************************************************************/
-void i2c_start_wait(unsigned char address) {
-  uint8_t   twst;
-
-
-  while (1) {
-    // send START condition
-    TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
-
-    // wait until transmission completed
-    while (!(TWCR & (1 << TWINT)));
-
-    // check value of TWI Status Register. Mask prescaler bits.
-    twst = TW_STATUS & 0xF8;
-
-    if ((twst != TW_START) && (twst != TW_REP_START)) continue;
-
-    // send device address
-    TWDR = address;
-    TWCR = (1 << TWINT) | (1 << TWEN);
-
-    // wail until transmission completed
-    while (!(TWCR & (1 << TWINT)));
-
-    // check value of TWI Status Register. Mask prescaler bits.
-    twst = TW_STATUS & 0xF8;
+unsigned char i2c_start_wait(unsigned char address) {
+  unsigned char ret = I2C_ERR_SLA_NACK;
 
-    if ((twst == TW_MT_SLA_NACK) || (twst == TW_MR_DATA_NACK)) {
-      /* device busy, send stop condition to terminate write operation */
-      TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
+  for (uint8_t retry = 0; retry < I2C_START_RETRIES; retry++) {
+    ret = i2c_start(address);
 
-      // wait until stop condition is executed and bus released
-      while (TWCR & (1 << TWSTO));
+    if (ret != I2C_ERR_SLA_NACK) break;
 
-      continue;
-    }
-
-    //if( twst != TW_MT_SLA_ACK) return 1;
-    break;
+    /* device busy, send stop condition to terminate write operation */
+    TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
   }
 
+  return ret;
+
 }/* i2c_start_wait */
 
 
@@ -121,8 +209,8 @@ void i2c_start_wait(unsigned char address) {
 
  Input:   address and transfer direction of I2C device
 
- Return:  0 device accessible
-          1 failed to access device
+ Return:  I2C_OK device accessible
+          else one of the I2C_ERR_* codes
 *************************************************************************/
 unsigned char i2c_rep_start(unsigned char address) {
   return i2c_start(address);
@@ -132,13 +220,15 @@ unsigned char i2c_rep_start(unsigned char address) {
 
 /*************************************************************************
  Terminates the data transfer and releases the I2C bus
+
+ Return:  I2C_OK or I2C_ERR_TIMEOUT
 *************************************************************************/
-void i2c_stop(void) {
+unsigned char i2c_stop(void) {
   /* send stop condition */
   TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
 
   // wait until stop condition is executed and bus released
-  while (TWCR & (1 << TWSTO));
+  return i2c_wait_stop();
 
 }/* i2c_stop */
 
@@ -147,8 +237,8 @@ void i2c_stop(void) {
   Send one byte to I2C device
 
   Input:    byte to be transfered
-  Return:   0 write successful
-            1 write failed
+  Return:   I2C_OK write successful
+            else one of the I2C_ERR_* codes
 *************************************************************************/
 unsigned char i2c_write(unsigned char data) {
   uint8_t   twst;
@@ -158,14 +248,14 @@ unsigned char i2c_write(unsigned char data) {
   TWCR = (1 << TWINT) | (1 << TWEN);
 
   // wait until transmission completed
-  while (!(TWCR & (1 << TWINT)));
+  if (i2c_wait() != I2C_OK) return I2C_ERR_TIMEOUT;
 
   // check value of TWI Status Register. Mask prescaler bits
   twst = TW_STATUS & 0xF8;
 
-  if (twst != TW_MT_DATA_ACK) return 1;
+  if (twst != TW_MT_DATA_ACK) return i2c_error(twst);
 
-  return 0;
+  return I2C_OK;
 
 }/* i2c_write */
 
@@ -173,14 +263,17 @@ unsigned char i2c_write(unsigned char data) {
 /*************************************************************************
  Read one byte from the I2C device, request more data from device
 
- Return:  byte read from I2C device
+ Output:  byte read from I2C device
+ Return:  I2C_OK or I2C_ERR_TIMEOUT
 *************************************************************************/
-unsigned char i2c_readAck(void) {
+unsigned char i2c_readAck(unsigned char *data) {
   TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);
 
-  while (!(TWCR & (1 << TWINT)));
+  if (i2c_wait() != I2C_OK) return I2C_ERR_TIMEOUT;
+
+  *data = TWDR;
 
-  return TWDR;
+  return I2C_OK;
 
 }/* i2c_readAck */
 
@@ -188,13 +281,292 @@ unsigned char i2c_readAck(void) {
 /*************************************************************************
  Read one byte from the I2C device, read is followed by a stop condition
 
- Return:  byte read from I2C device
+ Output:  byte read from I2C device
+ Return:  I2C_OK or I2C_ERR_TIMEOUT
 *************************************************************************/
-unsigned char i2c_readNak(void) {
+unsigned char i2c_readNak(unsigned char *data) {
   TWCR = (1 << TWINT) | (1 << TWEN);
 
-  while (!(TWCR & (1 << TWINT)));
+  if (i2c_wait() != I2C_OK) return I2C_ERR_TIMEOUT;
 
-  return TWDR;
+  *data = TWDR;
+
+  return I2C_OK;
 
 }/* i2c_readNak */
+
+
+/*************************************************************************
+ Free a bus with a slave holding SDA low (e.g. unplugged mid-transfer)
+
+ SCL/SDA are driven as open drain GPIOs: up to 9 clock pulses let the
+ slave finish its byte, then a STOP condition resets its state machine.
+ Takes about 100 us. The TWI is re-enabled with the previous clock.
+
+ Return:  I2C_OK bus is free, I2C_ERR_BUS SDA is still low
+*************************************************************************/
+unsigned char i2c_recover(void) {
+  uint8_t twbr = TWBR;
+
+  /* TWI off, SCL/SDA are GPIOs now: released (input, no pullup) */
+  TWCR = 0;
+  BIT_CLEAR(PORT_SCL, BIT_SCL);
+  BIT_CLEAR(PORT_SDA, BIT_SDA);
+  BIT_CLEAR(DDR_SCL, BIT_SCL);
+  BIT_CLEAR(DDR_SDA, BIT_SDA);
+  _delay_us(I2C_RECOVER_HALF_US);
+
+  /* clock until the slave releases SDA */
+  for (uint8_t i = 0; i < 9 && !BIT_GET(PIN_SDA, BIT_SDA); i++) {
+    BIT_SET(DDR_SCL, BIT_SCL);    /* SCL low */
+    _delay_us(I2C_RECOVER_HALF_US);
+    BIT_CLEAR(DDR_SCL, BIT_SCL);  /* SCL high */
+    _delay_us(I2C_RECOVER_HALF_US);
+  }
+
+  /* STOP: SDA goes high while SCL is high */
+  BIT_SET(DDR_SCL, BIT_SCL);
+  BIT_SET(DDR_SDA, BIT_SDA);
+  _delay_us(I2C_RECOVER_HALF_US);
+  BIT_CLEAR(DDR_SCL, BIT_SCL);
+  _delay_us(I2C_RECOVER_HALF_US);
+  BIT_CLEAR(DDR_SDA, BIT_SDA);
+  _delay_us(I2C_RECOVER_HALF_US);
+
+  /* back to TWI with the previous clock */
+  TWSR = 0;
+  TWBR = twbr;
+  TWCR = (1 << TWEN);
+
+  if (async_state == I2C_ASYNC_BUSY) async_state = I2C_ASYNC_ERROR;
+
+  i2c_fault = 0;
+
+  return BIT_GET(PIN_SDA, BIT_SDA) ? I2C_OK : I2C_ERR_BUS;
+
+}/* i2c_recover */
+
+
+/*************************************************************************
+ Interrupt driven transaction engine
+
+ One transaction (START, SLA+R/W, N data bytes, STOP) is queued with
+ i2c_async_start() and then clocked out byte by byte from TWI_vect.
+ The caller only polls i2c_async_state() and is free to do other work
+ while the bus is busy. The state lives at the top of this file.
+*************************************************************************/
+
+/*************************************************************************
+ Queue a complete transaction and send the start condition
+
+ Input:   address and transfer direction of I2C device
+          buffer to read into / write from
+          number of data bytes (> 0)
+
+ Return:  0 transaction started
+          1 engine is still busy
+*************************************************************************/
+unsigned char i2c_async_start(unsigned char address, unsigned char *buf,
+                              unsigned char len) {
+  return i2c_async_read_write(address, buf, len, 0, 0, 0);
+
+}/* i2c_async_start */
+
+
+/*************************************************************************
+ Queue a read followed by a write to the same device
+
+ The write is started right from the interrupt after the last byte was
+ read, either with a repeated start or with STOP+START in one go.
+
+ Input:   address and transfer direction of I2C device
+          buffer to read into / write from
+          number of data bytes (> 0)
+          buffer and number of bytes to write afterwards (0 = none)
+          1 = repeated start, 0 = stop and start before the write
+
+ Return:  0 transaction started
+          1 engine is still busy
+*************************************************************************/
+unsigned char i2c_async_read_write(unsigned char address, unsigned char *buf,
+                                   unsigned char len, unsigned char *tx,
+                                   unsigned char tx_len, unsigned char rep_start) {
+  if (async_state == I2C_ASYNC_BUSY) return 1;
+
+  async_addr  = address;
+  async_buf   = buf;
+  async_len   = len;
+  async_idx   = 0;
+  async_tx    = tx;
+  async_tx_len = tx_len;
+  async_in_tx = 0;
+  async_tx_start = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);
+
+  if (!rep_start) async_tx_start |= (1 << TWSTO);
+
+  async_error = I2C_OK;
+  async_time  = timer_millis();
+
+  // wait until a previous stop condition is executed and bus released
+  if (i2c_wait_stop() != I2C_OK) {
+    async_error = I2C_ERR_TIMEOUT;
+    async_state = I2C_ASYNC_ERROR;
+    return 0;
+  }
+
+  async_state = I2C_ASYNC_BUSY;
+
+  // send START condition, everything else happens in TWI_vect
+  TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);
+
+  return 0;
+
+}/* i2c_async_read_write */
+
+
+/*************************************************************************
+ State of the last queued transaction, a transaction taking longer than
+ I2C_ASYNC_TIMEOUT_MS (SCL held low, no interrupt) is aborted here.
+ A finished transaction stays busy until its STOP has left the bus, so
+ the caller can switch the port or the bus speed right after
+*************************************************************************/
+I2C_AsyncState i2c_async_state(void) {
+  I2C_AsyncState state;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    state = async_state;
+    if (state != I2C_ASYNC_IDLE && (TWCR & (1 << TWSTO)))
+      state = I2C_ASYNC_BUSY;           // STOP still on the bus
+    if (state == I2C_ASYNC_BUSY &&
+        (uint16_t)(timer_millis() - async_time) > I2C_ASYNC_TIMEOUT_MS) {
+      async_error = i2c_abort(I2C_ERR_TIMEOUT);
+      async_state = state = I2C_ASYNC_ERROR;
+    }
+  }
+
+  return state;
+
+}/* i2c_async_state */
+
+
+/*************************************************************************
+ Error code of the last queued transaction
+*************************************************************************/
+unsigned char i2c_async_error(void) {
+  return async_error;
+
+}/* i2c_async_error */
+
+
+/*************************************************************************
+ Timeout or bus error since the last call?
+*************************************************************************/
+unsigned char i2c_get_fault(void) {
+  uint8_t fault = i2c_fault;
+
+  i2c_fault = 0;
+
+  return fault;
+
+}/* i2c_get_fault */
+
+
+/*************************************************************************
+ Send stop condition from interrupt context and finish the transaction
+*************************************************************************/
+static inline void i2c_async_finish(I2C_AsyncState state) {
+  TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO); // TWIE off
+  async_state = state;
+
+}/* i2c_async_finish */
+
+
+/*************************************************************************
+ Abort the transaction from interrupt context
+*************************************************************************/
+static inline void i2c_async_fail(uint8_t twst) {
+  // data of a read is still valid if only the follow-up write fails
+  I2C_AsyncState state = async_in_tx ? I2C_ASYNC_DONE : I2C_ASYNC_ERROR;
+
+  async_error = i2c_error(twst);
+
+  if (async_error == I2C_ERR_ARB_LOST) {
+    TWCR = (1 << TWINT) | (1 << TWEN);  // release the bus, no stop
+    async_state = state;
+  } else if (async_error == I2C_ERR_BUS) {
+    async_state = state;                // TWI already disabled
+  } else {
+    i2c_async_finish(state);
+  }
+
+}/* i2c_async_fail */
+
+
+ISR(TWI_vect) {
+  uint8_t twst = TW_STATUS & 0xF8;
+
+  /* TWIE off (TWINT stays set), then let the paddle triggers (INT0/INT1)
+     in. Every case writes TWCR last, only that enables TWIE again. */
+  TWCR = (1 << TWEN);
+#if ISR_NESTING
+  sei();
+#endif
+
+  switch (twst) {
+
+    // start condition transmitted, send device address
+    case TW_START:
+    case TW_REP_START:
+      TWDR = async_addr;
+      TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+      break;
+
+    // master transmitter, send next byte or stop
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if (async_idx < async_len) {
+        TWDR = async_buf[async_idx++];
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+      } else {
+        i2c_async_finish(I2C_ASYNC_DONE);
+      }
+      break;
+
+    // master receiver, byte received and acked: store it
+    case TW_MR_DATA_ACK:
+      async_buf[async_idx++] = TWDR;
+      // fall through
+
+    // master receiver, ack the next byte unless it is the last one
+    case TW_MR_SLA_ACK:
+      if (async_idx + 1 < async_len) {
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE) | (1 << TWEA);
+      } else {
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+      }
+      break;
+
+    // master receiver, last byte received and nacked
+    case TW_MR_DATA_NACK:
+      async_buf[async_idx++] = TWDR;
+
+      // go on with the follow-up write
+      if (async_tx_len) {
+        async_addr = (async_addr & ~I2C_READ) | I2C_WRITE;
+        async_buf  = async_tx;
+        async_len  = async_tx_len;
+        async_idx  = 0;
+        async_tx_len = 0;
+        async_in_tx = 1;
+        TWCR = async_tx_start;
+      } else {
+        i2c_async_finish(I2C_ASYNC_DONE);
+      }
+      break;
+
+    // address or data nacked, arbitration lost, bus error
+    default:
+      i2c_async_fail(twst);
+      break;
+  }
+}
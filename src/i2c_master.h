@@ -76,7 +76,7 @@ test_i2cmaster.c
      i2c_write(0x05);                        // write address = 5
      i2c_rep_start(Dev24C02+I2C_READ);       // set device address and read mode
 
-     ret = i2c_readNak();                    // read one byte from EEPROM
+     i2c_readNak(&ret);                      // read one byte from EEPROM
      i2c_stop();
 
      for(;;);
@@ -104,6 +104,41 @@ i2c_start(),i2c_rep_start() */
 #define I2C_WRITE   0
 
 
+/** @name status codes returned by the I2C functions */
+/**@{*/
+#define I2C_OK             0 ///< success
+#define I2C_ERR_ARB_LOST   1 ///< arbitration lost
+#define I2C_ERR_SLA_NACK   2 ///< device address not acknowledged
+#define I2C_ERR_DATA_NACK  3 ///< data byte not acknowledged
+#define I2C_ERR_TIMEOUT    4 ///< TWI didn't finish in time (SCL/SDA stuck)
+#define I2C_ERR_BUS        5 ///< illegal start/stop condition or bad state
+/**@}*/
+
+/** maximum time to wait for one byte in the blocking functions */
+#define I2C_TIMEOUT_US        1000
+
+/** maximum duration of a transaction queued with i2c_async_start() */
+#define I2C_ASYNC_TIMEOUT_MS  3
+
+/** ack polling attempts of i2c_start_wait() */
+#define I2C_START_RETRIES     20
+
+
+/** I2C clock speeds, fastest first */
+typedef enum {
+  I2C_400KHZ,         ///< fast mode
+  I2C_200KHZ,
+  I2C_100KHZ,         ///< standard mode
+  I2C_50KHZ,          ///< safe fallback for picky clones
+
+  I2C_NUMBER_SPEEDS
+} I2C_Speed;
+
+/** fastest and slowest I2C clock */
+#define I2C_FASTEST  I2C_400KHZ
+#define I2C_SLOWEST  I2C_50KHZ
+
+
 /**
  @brief initialize the I2C master interace. Need to be called only once
  @param  void
@@ -112,20 +147,29 @@ i2c_start(),i2c_rep_start() */
 extern void i2c_init(void);
 
 
+/**
+ @brief change the I2C clock, only call while the bus is idle
+ @param  speed one of I2C_Speed
+ @return none
+ */
+extern void i2c_set_speed(I2C_Speed speed);
+
+
 /**
  @brief Terminates the data transfer and releases the I2C bus
  @param void
- @return none
+ @retval I2C_OK
+ @retval I2C_ERR_TIMEOUT
  */
-extern void i2c_stop(void);
+extern unsigned char i2c_stop(void);
 
 
 /**
  @brief Issues a start condition and sends address and transfer direction
 
  @param    addr address and transfer direction of I2C device
- @retval   0   device accessible
- @retval   1   failed to access device
+ @retval   I2C_OK   device accessible
+ @retval   I2C_ERR_* failed to access device
  */
 extern unsigned char i2c_start(unsigned char addr);
 
@@ -135,8 +179,8 @@ extern unsigned char i2c_start(unsigned char addr);
 direction
 
  @param   addr address and transfer direction of I2C device
- @retval  0 device accessible
- @retval  1 failed to access device
+ @retval  I2C_OK device accessible
+ @retval  I2C_ERR_* failed to access device
  */
 extern unsigned char i2c_rep_start(unsigned char addr);
 
@@ -144,46 +188,133 @@ extern unsigned char i2c_rep_start(unsigned char addr);
 /**
  @brief Issues a start condition and sends address and transfer direction
 
- If device is busy, use ack polling to wait until device ready
+ If device is busy, use ack polling to wait until device ready,
+ gives up after I2C_START_RETRIES attempts
  @param    addr address and transfer direction of I2C device
- @return   none
+ @retval   I2C_OK   device accessible
+ @retval   I2C_ERR_* failed to access device
  */
-extern void i2c_start_wait(unsigned char addr);
+extern unsigned char i2c_start_wait(unsigned char addr);
 
 
 /**
  @brief Send one byte to I2C device
  @param    data  byte to be transfered
- @retval   0 write successful
- @retval   1 write failed
+ @retval   I2C_OK write successful
+ @retval   I2C_ERR_* write failed
  */
 extern unsigned char i2c_write(unsigned char data);
 
 
 /**
  @brief    read one byte from the I2C device, request more data from device
- @return   byte read from I2C device
+ @param    data byte read from I2C device
+ @retval   I2C_OK
+ @retval   I2C_ERR_TIMEOUT
  */
-extern unsigned char i2c_readAck(void);
+extern unsigned char i2c_readAck(unsigned char *data);
 
 /**
  @brief    read one byte from the I2C device, read is followed by a stop
 condition
- @return   byte read from I2C device
+ @param    data byte read from I2C device
+ @retval   I2C_OK
+ @retval   I2C_ERR_TIMEOUT
  */
-extern unsigned char i2c_readNak(void);
+extern unsigned char i2c_readNak(unsigned char *data);
 
 /**
  @brief    read one byte from the I2C device
 
  Implemented as a macro, which calls either i2c_readAck or i2c_readNak
 
+ @param    data byte read from I2C device
  @param    ack 1 send ack, request more data from device<br>
                0 send nak, read is followed by a stop condition
- @return   byte read from I2C device
+ @retval   I2C_OK
+ @retval   I2C_ERR_TIMEOUT
+ */
+extern unsigned char i2c_read(unsigned char *data, unsigned char ack);
+#define i2c_read(data, ack)  ((ack) ? i2c_readAck(data) : i2c_readNak(data))
+
+
+
+/** state of the interrupt driven transaction engine */
+typedef enum {
+  I2C_ASYNC_IDLE,   ///< nothing queued yet
+  I2C_ASYNC_BUSY,   ///< transaction in progress
+  I2C_ASYNC_DONE,   ///< transaction completed
+  I2C_ASYNC_ERROR   ///< transaction aborted (NACK, arbitration, bus error)
+} I2C_AsyncState;
+
+/**
+ @brief    Queue a complete transaction (start, address, len bytes, stop)
+
+ The transaction is driven by the TWI interrupt, global interrupts must be
+ enabled. Poll i2c_async_state() for completion, the buffer must stay valid
+ until then. Do not mix with the blocking functions while busy.
+ @param    addr address and transfer direction of I2C device
+ @param    buf  buffer to read into (I2C_READ) or write from (I2C_WRITE)
+ @param    len  number of data bytes, at least 1
+ @retval   0 transaction started
+ @retval   1 engine is busy
+ */
+extern unsigned char i2c_async_start(unsigned char addr, unsigned char *buf,
+                                     unsigned char len);
+
+/**
+ @brief    Queue a read followed by a write to the same device
+
+ Like i2c_async_start(), but after the last byte is read the interrupt
+ immediately addresses the device again and writes tx_len bytes, e.g. a
+ register pointer for the next read. Only one completion for both.
+ If only the write fails the state is still I2C_ASYNC_DONE (data valid),
+ i2c_async_error() returns the reason.
+ @param    addr address of I2C device with I2C_READ
+ @param    buf  buffer to read into
+ @param    len  number of bytes to read, at least 1
+ @param    tx   buffer to write from afterwards
+ @param    tx_len number of bytes to write, 0 = no write
+ @param    rep_start 1 = repeated start, 0 = STOP followed by START
+ @retval   0 transaction started
+ @retval   1 engine is busy
+ */
+extern unsigned char i2c_async_read_write(unsigned char addr, unsigned char *buf,
+                                          unsigned char len, unsigned char *tx,
+                                          unsigned char tx_len,
+                                          unsigned char rep_start);
+
+/**
+ @brief    state of the last queued transaction
+
+ Stays I2C_ASYNC_BUSY until the closing STOP has left the bus, so the
+ port and the bus speed may be switched as soon as it returns otherwise.
+ @return   I2C_AsyncState
+ */
+extern I2C_AsyncState i2c_async_state(void);
+
+/**
+ @brief    error code of the last queued transaction
+ @retval   I2C_OK
+ @retval   I2C_ERR_* reason of the abort
+ */
+extern unsigned char i2c_async_error(void);
+
+/**
+ @brief    timeout or bus error seen since the last call
+ @return   1 the bus may be stuck, 0 no fault
+ */
+extern unsigned char i2c_get_fault(void);
+
+/**
+ @brief    free a stuck bus (slave holding SDA low)
+
+ Takes SCL/SDA as GPIOs, clocks up to 9 pulses, sends a STOP and enables
+ the TWI again with the previous clock. Takes about 100 us.
+ @retval   I2C_OK bus is free
+ @retval   I2C_ERR_BUS SDA is still held low
  */
-extern unsigned char i2c_read(unsigned char ack);
-#define i2c_read(ack)  (ack) ? i2c_readAck() : i2c_readNak();
+extern unsigned char i2c_recover(void);
 
 
 /**@}*/
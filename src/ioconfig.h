@@ -30,6 +30,22 @@
 #define BIT_CLEAR(ADR,BIT) ((ADR) &= ~(_BV(BIT)))
 #define BIT_FLIP(ADR,BIT)  ((ADR) ^= (_BV(BIT)))
 
+// avr port of a pin, for compile time pin masks
+#define IO_B                   0 ///< PORTB / DDRB / PINB
+#define IO_C                   1 ///< PORTC / DDRC / PINC
+#define IO_D                   2 ///< PORTD / DDRD / PIND
+#define NUMBER_IO              3 ///< number of avr ports
+
+// mask of pin SIG on avr port IO, 0 if the pin is on another port
+#define IO_MASK(SIG,IO)    ((IO_##SIG == (IO)) ? _BV(BIT_##SIG) : 0)
+
+// IO_##SIG is the avr port of DDR_##SIG and PORT_##SIG
+#define IO_ADDR(IO,REG)    (((IO) == IO_B) ? _SFR_MEM_ADDR(REG##B) : \
+                            ((IO) == IO_C) ? _SFR_MEM_ADDR(REG##C) : _SFR_MEM_ADDR(REG##D))
+#define IO_CHECK(SIG)      _Static_assert(_SFR_MEM_ADDR(DDR_##SIG)  == IO_ADDR(IO_##SIG, DDR) && \
+                                          _SFR_MEM_ADDR(PORT_##SIG) == IO_ADDR(IO_##SIG, PORT), \
+                                          "IO_" #SIG " doesn't match DDR_" #SIG " / PORT_" #SIG)
+
 // ========================================================
 //  LED
 // ========================================================
@@ -63,6 +79,22 @@
 #define DDR_SEL2            DDRC // PC1
 #define BIT_SEL2               1 // PC1
 
+// ========================================================
+//  I2C (TWI), only used as GPIO for bus recovery
+// ========================================================
+
+// scl port, ddr and bit
+#define PIN_SCL             PINC // PC5
+#define PORT_SCL           PORTC // PC5
+#define DDR_SCL             DDRC // PC5
+#define BIT_SCL                5 // PC5
+
+// sda port, ddr and bit
+#define PIN_SDA             PINC // PC4
+#define PORT_SDA           PORTC // PC4
+#define DDR_SDA             DDRC // PC4
+#define BIT_SDA                4 // PC4
+
 // ========================================================
 //  DIGITAL JOYSTICK OUTPUTS
 // ========================================================
@@ -74,14 +106,14 @@
 #define PORT_JOY_A3        PORTC // PC2
 #define PORT_BUTTON_A      PORTB // PB7
 #define PORT_BUTTON2_A     PORTB // PB1
-#define PORT_BUTTON3_A     PORTB // PB2 
+#define PORT_BUTTON3_A     PORTB // PB2
 #define PORT_JOY_B0        PORTB // PB5
 #define PORT_JOY_B1        PORTB // PB3
 #define PORT_JOY_B2        PORTB // PB0
 #define PORT_JOY_B3        PORTD // PD7
 #define PORT_BUTTON_B      PORTB // PB4
-#define PORT_BUTTON2_B     PORTD // PD5
-#define PORT_BUTTON3_B     PORTD // PD6
+#define PORT_BUTTON2_B     PORTD // PD6
+#define PORT_BUTTON3_B     PORTD // PD5
 
 
 // ddr for joystick outputs
@@ -116,6 +148,37 @@
 #define BIT_BUTTON2_B          6 // PD6
 #define BIT_BUTTON3_B          5 // PD5
 
+// avr port of joystick outputs (checked against the registers above)
+#define IO_JOY_A0           IO_D // PD1
+#define IO_JOY_A1           IO_D // PD0
+#define IO_JOY_A2           IO_C // PC3
+#define IO_JOY_A3           IO_C // PC2
+#define IO_BUTTON_A         IO_B // PB7
+#define IO_BUTTON2_A        IO_B // PB1
+#define IO_BUTTON3_A        IO_B // PB2
+#define IO_JOY_B0           IO_B // PB5
+#define IO_JOY_B1           IO_B // PB3
+#define IO_JOY_B2           IO_B // PB0
+#define IO_JOY_B3           IO_D // PD7
+#define IO_BUTTON_B         IO_B // PB4
+#define IO_BUTTON2_B        IO_D // PD6
+#define IO_BUTTON3_B        IO_D // PD5
+
+IO_CHECK(JOY_A0);
+IO_CHECK(JOY_A1);
+IO_CHECK(JOY_A2);
+IO_CHECK(JOY_A3);
+IO_CHECK(BUTTON_A);
+IO_CHECK(BUTTON2_A);
+IO_CHECK(BUTTON3_A);
+IO_CHECK(JOY_B0);
+IO_CHECK(JOY_B1);
+IO_CHECK(JOY_B2);
+IO_CHECK(JOY_B3);
+IO_CHECK(BUTTON_B);
+IO_CHECK(BUTTON2_B);
+IO_CHECK(BUTTON3_B);
+
 // ========================================================
 //  PADDLE INPUTS & OUTPUTS
 // ========================================================
@@ -138,6 +201,10 @@
 #define DDR_PADDLE_B_X      DDRD // PD6
 #define DDR_PADDLE_B_Y      DDRD // PD5
 
+// pin for paddle sense (calibration)
+#define PIN_SENSE_A         PIND // PD2
+#define PIN_SENSE_B         PIND // PD3
+
 // bits for paddle sense
 #define BIT_SENSE_A            2 // PD2
 #define BIT_PADDLE_A_X         1 // PB1
@@ -20,11 +20,78 @@
 /// @date   December, 2017
 /// @brief  digital joystick part
 //=============================================================================
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
 #include "ioconfig.h"
+#include "enums.h"
+#include "timer.h"
 
 #include "joystick.h"
 
+/// \brief autofire period per rate [ms]
+const uint8_t AUTOFIRE_PERIOD[NUMBER_RATES] PROGMEM = {
+  200, // RATE_5HZ
+  125, // RATE_8HZ
+  100, // RATE_10HZ
+  80,  // RATE_12HZ
+  67,  // RATE_15HZ
+  50,  // RATE_20HZ
+  40   // RATE_25HZ
+};
+
+/// \brief autofire of one fire line
+typedef struct {
+  uint8_t time;   ///< time in the current period [ms]
+  uint8_t period; ///< [ms]
+  uint8_t on;     ///< pressed part of the period [ms]
+  uint8_t duty;   ///< pressed part of the period [%]
+} Autofire;
+
+static Autofire af[NUMBER_PORTS][NUMBER_FIRES];
+static volatile uint8_t af_rate[NUMBER_PORTS];    ///< AutofireRate per port
+static volatile uint8_t af_running[NUMBER_PORTS]; ///< _BV(Fire) ... autofire running
+static volatile uint8_t af_pressed[NUMBER_PORTS]; ///< _BV(Fire) ... pressed part of the period
+
+void joystick_set_autofire(Port port, Fire fire, uint8_t rate, uint8_t duty) {
+  uint8_t period = pgm_read_byte(&AUTOFIRE_PERIOD[rate]);
+  uint8_t on = ((uint16_t)period * duty) / 100;
+
+  // at least 1 ms pressed and released
+  if (on == 0)
+    on = 1;
+  else if (on >= period)
+    on = period - 1;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    af[port][fire].period = period;
+    af[port][fire].on = on;
+    af[port][fire].duty = duty;
+
+    if (af[port][fire].time >= period)
+      af[port][fire].time = 0;
+  }
+
+  af_rate[port] = rate;
+}
+
+static void next_rate(Port port) {
+  uint8_t rate = af_rate[port] + 1;
+
+  if (rate >= NUMBER_RATES)
+    rate = 0;
+
+  for (Fire f = FIRE_1; f < NUMBER_FIRES; f++)
+    joystick_set_autofire(port, f, rate, af[port][f].duty);
+}
+
 void joystick_init(void) {
+  // autofire defaults
+  for (Port p = PORT_A; p < NUMBER_PORTS; p++) {
+    for (Fire f = FIRE_1; f < NUMBER_FIRES; f++)
+      joystick_set_autofire(p, f, AUTOFIRE_RATE_DEFAULT, AUTOFIRE_DUTY_DEFAULT);
+  }
+
   // NOTE not needed, default after reset
 
   /*
@@ -59,277 +126,282 @@ void joystick_init(void) {
 static volatile Joystick port_a_old = 0;
 static volatile Joystick port_b_old = 0;
 
-static volatile uint8_t  autofire_a = 0;
-static volatile uint8_t  autofire_b = 0;
+static volatile uint8_t  ext_a_old = 1;
+static volatile uint8_t  ext_b_old = 1;
+
+/// \brief pins of one C64 port on one avr port
+typedef struct {
+  uint8_t own_ddr;  ///< DDR bits written
+  uint8_t ddr;      ///< DDR bits set (joystick lines: pull low, pot lines: drive)
+  uint8_t own_port; ///< PORT bits written
+  uint8_t port;     ///< PORT bits set (pot lines: high)
+} Masks;
+
+// DDR bits of the fire lines (_BV(Fire)) of a port
+static inline uint8_t fire_mask(Port port, uint8_t io, uint8_t lines) {
+  if (port == PORT_A)
+    return ((lines & _BV(FIRE_1)) ? IO_MASK(BUTTON_A,  io) : 0) |
+           ((lines & _BV(FIRE_2)) ? IO_MASK(BUTTON2_A, io) : 0) |
+           ((lines & _BV(FIRE_3)) ? IO_MASK(BUTTON3_A, io) : 0);
+  else
+    return ((lines & _BV(FIRE_1)) ? IO_MASK(BUTTON_B,  io) : 0) |
+           ((lines & _BV(FIRE_2)) ? IO_MASK(BUTTON2_B, io) : 0) |
+           ((lines & _BV(FIRE_3)) ? IO_MASK(BUTTON3_B, io) : 0);
+}
 
-static volatile uint8_t  autofire2_a = 0;
-static volatile uint8_t  autofire2_b = 0;
+// pot lines are driven high, DDR & PORT
+static inline uint8_t pot_mask(uint8_t io) {
+  return IO_MASK(BUTTON2_A, io) | IO_MASK(BUTTON3_A, io) |
+         IO_MASK(BUTTON2_B, io) | IO_MASK(BUTTON3_B, io);
+}
 
-static volatile uint8_t  autofire3_a = 0;
-static volatile uint8_t  autofire3_b = 0;
+static inline void masks_a(Masks *m, uint8_t io, Joystick port_a, uint8_t owned, uint8_t lines) {
+  // joystick lines
+  m->own_ddr = IO_MASK(JOY_A0, io) | IO_MASK(JOY_A1, io) | IO_MASK(JOY_A2, io) | IO_MASK(JOY_A3, io);
+  m->ddr = ((port_a & UP)    ? IO_MASK(JOY_A0, io) : 0) |
+           ((port_a & DOWN)  ? IO_MASK(JOY_A1, io) : 0) |
+           ((port_a & LEFT)  ? IO_MASK(JOY_A2, io) : 0) |
+           ((port_a & RIGHT) ? IO_MASK(JOY_A3, io) : 0);
+
+  // fire lines
+  m->own_ddr |= fire_mask(PORT_A, io, owned);
+  m->ddr |= fire_mask(PORT_A, io, lines);
+  m->own_port = fire_mask(PORT_A, io, owned) & pot_mask(io);
+  m->port = fire_mask(PORT_A, io, lines) & pot_mask(io);
+}
 
-void joystick_update(Joystick port_a, uint8_t ext_a,
-                     Joystick port_b, uint8_t ext_b) {
+static inline void masks_b(Masks *m, uint8_t io, Joystick port_b, uint8_t owned, uint8_t lines) {
+  // joystick lines
+  m->own_ddr = IO_MASK(JOY_B0, io) | IO_MASK(JOY_B1, io) | IO_MASK(JOY_B2, io) | IO_MASK(JOY_B3, io);
+  m->ddr = ((port_b & UP)    ? IO_MASK(JOY_B0, io) : 0) |
+           ((port_b & DOWN)  ? IO_MASK(JOY_B1, io) : 0) |
+           ((port_b & LEFT)  ? IO_MASK(JOY_B2, io) : 0) |
+           ((port_b & RIGHT) ? IO_MASK(JOY_B3, io) : 0);
+
+  // fire lines
+  m->own_ddr |= fire_mask(PORT_B, io, owned);
+  m->ddr |= fire_mask(PORT_B, io, lines);
+  m->own_port = fire_mask(PORT_B, io, owned) & pot_mask(io);
+  m->port = fire_mask(PORT_B, io, lines) & pot_mask(io);
+}
 
-  if (ext_a == 0) {
-    autofire2_a = autofire3_a = 0;
+static void write_masks(const Masks m[NUMBER_IO]) {
+  // one write per register, all edges at the same time,
+  // no interrupt can modify the registers in between
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    DDRB  = (DDRB  & ~m[IO_B].own_ddr)  | m[IO_B].ddr;
+    PORTB = (PORTB & ~m[IO_B].own_port) | m[IO_B].port;
+    DDRC  = (DDRC  & ~m[IO_C].own_ddr)  | m[IO_C].ddr;
+    PORTC = (PORTC & ~m[IO_C].own_port) | m[IO_C].port;
+    DDRD  = (DDRD  & ~m[IO_D].own_ddr)  | m[IO_D].ddr;
+    PORTD = (PORTD & ~m[IO_D].own_port) | m[IO_D].port;
   }
+}
 
-  if (ext_b == 0) {
-    autofire2_b = autofire3_b = 0;
-  }
+// fire lines (_BV(Fire)) of a port, starts and stops autofire
+static uint8_t fire_lines(Port port, Joystick state, uint8_t ext, uint8_t fire) {
+  uint8_t pressed = fire ? _BV(FIRE_1) : 0;
+  uint8_t autofire = (fire == 0 && (state & AUTOFIRE)) ? _BV(FIRE_1) : 0;
 
-  // look if same change?
-  if (port_a == port_a_old && port_b == port_b_old) {
-    // nothing changed
-    return;
-  }
+  // pot lines, only if not used by the paddle
+  if (ext) {
+    pressed |= (state & BUTTON2) ? _BV(FIRE_2) : 0;
+    pressed |= (state & BUTTON3) ? _BV(FIRE_3) : 0;
 
-  port_a_old = port_a;
-  port_b_old = port_b;
+    autofire |= ((state & BUTTON2) == 0 && (state & AUTOFIRE2)) ? _BV(FIRE_2) : 0;
+    autofire |= ((state & BUTTON3) == 0 && (state & AUTOFIRE3)) ? _BV(FIRE_3) : 0;
+  }
 
-  // ===================================
-  //  CONTROL PORT A
-  // ===================================
+  // first shot right on the press
+  uint8_t started = autofire & ~af_running[port];
 
-  // UP
-  if (port_a & UP) {
-    BIT_SET(DDR_JOY_A0, BIT_JOY_A0);
-  } else {
-    BIT_CLEAR(DDR_JOY_A0, BIT_JOY_A0);
+  for (Fire f = FIRE_1; f < NUMBER_FIRES; f++) {
+    if (started & _BV(f))
+      af[port][f].time = 0;
   }
 
-  // DOWN
-  if (port_a & DOWN) {
-    BIT_SET(DDR_JOY_A1, BIT_JOY_A1);
-  } else {
-    BIT_CLEAR(DDR_JOY_A1, BIT_JOY_A1);
-  }
+  af_pressed[port] |= started;
+  af_running[port] = autofire;
 
-  // LEFT
-  if (port_a & LEFT) {
-    BIT_SET(DDR_JOY_A2, BIT_JOY_A2);
-  } else {
-    BIT_CLEAR(DDR_JOY_A2, BIT_JOY_A2);
-  }
+  return pressed | (autofire & af_pressed[port]);
+}
 
-  // RIGHT
-  if (port_a & RIGHT) {
-    BIT_SET(DDR_JOY_A3, BIT_JOY_A3);
-  } else {
-    BIT_CLEAR(DDR_JOY_A3, BIT_JOY_A3);
-  }
+static void update_port_a(Joystick port_a, uint8_t ext_a, uint8_t space) {
+  Masks m[NUMBER_IO];
 
   // BUTTON (small hack to simulate SPACE on both contollers)
-  if (port_a & BUTTON || port_a & SPACE || port_b & SPACE) {
-    BIT_SET(DDR_BUTTON_A, BIT_BUTTON_A);
-  } else {
+  uint8_t fire = (port_a & BUTTON || port_a & SPACE || space) ? 1 : 0;
 
-    // AUTOFIRE BUTTON
-    if (port_a & AUTOFIRE) {
-      autofire_a = 1;
+  // pot lines are owned by the paddle without ext
+  uint8_t owned = ext_a ? (_BV(FIRE_1) | _BV(FIRE_2) | _BV(FIRE_3)) : _BV(FIRE_1);
 
-      // neither AUTOFIRE nor FIRE BUTTON
-    } else {
-      autofire_a = 0;
-      BIT_CLEAR(DDR_BUTTON_A, BIT_BUTTON_A);
-    }
-  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uint8_t lines = fire_lines(PORT_A, port_a, ext_a, fire);
 
-  if (ext_a) {
-    // BUTTON2
-    if (port_a & BUTTON2) {
-      BIT_SET(DDR_BUTTON2_A, BIT_BUTTON2_A);
-      BIT_SET(PORT_BUTTON2_A, BIT_BUTTON2_A);
-    } else {
-
-      // AUTOFIRE2 BUTTON
-      if (port_a & AUTOFIRE2) {
-        autofire2_a = 1;
-
-        // neither AUTOFIRE2 nor FIRE BUTTON2
-      } else {
-        autofire2_a = 0;
-        BIT_CLEAR(DDR_BUTTON2_A, BIT_BUTTON2_A);
-        BIT_CLEAR(PORT_BUTTON2_A, BIT_BUTTON2_A);
-      }
-    }
+    // masks are constant folded for each avr port
+    masks_a(&m[IO_B], IO_B, port_a, owned, lines);
+    masks_a(&m[IO_C], IO_C, port_a, owned, lines);
+    masks_a(&m[IO_D], IO_D, port_a, owned, lines);
 
-    // BUTTON3
-    if (port_a & BUTTON3) {
-      BIT_SET(DDR_BUTTON3_A, BIT_BUTTON3_A);
-      BIT_SET(PORT_BUTTON3_A, BIT_BUTTON3_A);
-    } else {
-
-      // AUTOFIRE4 BUTTON
-      if (port_a & AUTOFIRE3) {
-        autofire3_a = 1;
-
-        // neither AUTOFIRE3 nor FIRE BUTTON3
-      } else {
-        autofire3_a = 0;
-        BIT_CLEAR(DDR_BUTTON3_A, BIT_BUTTON3_A);
-        BIT_CLEAR(PORT_BUTTON3_A, BIT_BUTTON3_A);
-      }
-    }
+    write_masks(m);
   }
+}
 
-  // ===================================
-  //  CONTROL PORT B
-  // ===================================
+static void update_port_b(Joystick port_b, uint8_t ext_b) {
+  Masks m[NUMBER_IO];
 
-  // UP
-  if (port_b & UP) {
-    BIT_SET(DDR_JOY_B0, BIT_JOY_B0);
-  } else {
-    BIT_CLEAR(DDR_JOY_B0, BIT_JOY_B0);
-  }
+  uint8_t fire = (port_b & BUTTON) ? 1 : 0;
 
-  // DOWN
-  if (port_b & DOWN) {
-    BIT_SET(DDR_JOY_B1, BIT_JOY_B1);
-  } else {
-    BIT_CLEAR(DDR_JOY_B1, BIT_JOY_B1);
-  }
+  // pot lines are owned by the paddle without ext
+  uint8_t owned = ext_b ? (_BV(FIRE_1) | _BV(FIRE_2) | _BV(FIRE_3)) : _BV(FIRE_1);
 
-  // LEFT
-  if (port_b & LEFT) {
-    BIT_SET(DDR_JOY_B2, BIT_JOY_B2);
-  } else {
-    BIT_CLEAR(DDR_JOY_B2, BIT_JOY_B2);
-  }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    uint8_t lines = fire_lines(PORT_B, port_b, ext_b, fire);
 
-  // RIGHT
-  if (port_b & RIGHT) {
-    BIT_SET(DDR_JOY_B3, BIT_JOY_B3);
-  } else {
-    BIT_CLEAR(DDR_JOY_B3, BIT_JOY_B3);
+    // masks are constant folded for each avr port
+    masks_b(&m[IO_B], IO_B, port_b, owned, lines);
+    masks_b(&m[IO_C], IO_C, port_b, owned, lines);
+    masks_b(&m[IO_D], IO_D, port_b, owned, lines);
+
+    write_masks(m);
   }
+}
 
-  // BUTTON
-  if (port_b & BUTTON) {
-    BIT_SET(DDR_BUTTON_B, BIT_BUTTON_B);
-  } else {
+static void commit(Port port, Joystick state, uint8_t ext) {
 
-    // AUTOFIRE BUTTON
-    if (port_b & AUTOFIRE) {
-      autofire_b = 1;
+  // next autofire rate on the press
+  if ((state & ~(port == PORT_A ? port_a_old : port_b_old)) & AUTOFIRE_RATE)
+    next_rate(port);
 
-      // neither AUTOFIRE nor FIRE BUTTON
-    } else {
-      autofire_b = 0;
-      BIT_CLEAR(DDR_BUTTON_B, BIT_BUTTON_B);
+  if (port == PORT_A) {
+    // look if same change?
+    if (state == port_a_old && ext == ext_a_old) {
+      // nothing changed
+      return;
     }
-  }
 
-  if (ext_b) {
-    // BUTTON2
-    if (port_b & BUTTON2) {
-      BIT_SET(DDR_BUTTON2_B, BIT_BUTTON2_B);
-      BIT_SET(PORT_BUTTON2_B, BIT_BUTTON2_B);
-    } else {
-
-      // AUTOFIRE2 BUTTON
-      if (port_b & AUTOFIRE2) {
-        autofire2_b = 1;
-
-        // neither AUTOFIRE2 nor FIRE BUTTON2
-      } else {
-        autofire2_b = 0;
-        BIT_CLEAR(DDR_BUTTON2_B, BIT_BUTTON2_B);
-        BIT_CLEAR(PORT_BUTTON2_B, BIT_BUTTON2_B);
-      }
-    }
+    port_a_old = state;
+    ext_a_old = ext;
 
-    // BUTTON3
-    if (port_b & BUTTON3) {
-      BIT_SET(DDR_BUTTON3_B, BIT_BUTTON3_B);
-      BIT_SET(PORT_BUTTON3_B, BIT_BUTTON3_B);
-    } else {
-
-      // AUTOFIRE3 BUTTON
-      if (port_b & AUTOFIRE3) {
-        autofire3_b = 1;
-
-        // neither AUTOFIRE3 nor FIRE BUTTON3
-      } else {
-        autofire3_b = 0;
-        BIT_CLEAR(DDR_BUTTON3_B, BIT_BUTTON3_B);
-        BIT_CLEAR(PORT_BUTTON3_B, BIT_BUTTON3_B);
-      }
+    update_port_a(state, ext, port_b_old & SPACE);
+
+  } else {
+    // look if same change?
+    if (state == port_b_old && ext == ext_b_old) {
+      // nothing changed
+      return;
     }
-  }
-}
 
-void joystick_poll(void) {
+    uint8_t space_changed = ((state ^ port_b_old) & SPACE) ? TRUE : FALSE;
 
-  // ===================================
-  //  CONTROL PORT A
-  // ===================================
+    port_b_old = state;
+    ext_b_old = ext;
 
-  if (autofire_a == 1) {
-    // toggle FIRE A
-    if (bit_is_set(DDR_BUTTON_A, BIT_BUTTON_A)) {
-      BIT_CLEAR(DDR_BUTTON_A, BIT_BUTTON_A);
-    } else {
-      BIT_SET(DDR_BUTTON_A, BIT_BUTTON_A);
-    }
-  }
+    update_port_b(state, ext);
 
-  if (autofire2_a == 1) {
-    // toggle FIRE2 A
-    if (bit_is_set(DDR_BUTTON2_A, BIT_BUTTON2_A)) {
-      BIT_CLEAR(DDR_BUTTON2_A, BIT_BUTTON2_A);
-      BIT_CLEAR(PORT_BUTTON2_A, BIT_BUTTON2_A);
-    } else {
-      BIT_SET(DDR_BUTTON2_A, BIT_BUTTON2_A);
-      BIT_SET(PORT_BUTTON2_A, BIT_BUTTON2_A);
-    }
+    // SPACE on port B also presses fire on port A
+    if (space_changed == TRUE)
+      update_port_a(port_a_old, ext_a_old, state & SPACE);
   }
+}
+
+void joystick_refresh(Port port) {
+  // write the last state again, something else had the lines
+  if (port == PORT_A)
+    update_port_a(port_a_old, ext_a_old, port_b_old & SPACE);
+  else
+    update_port_b(port_b_old, ext_b_old);
+}
 
-  if (autofire3_a == 1) {
-    // toggle FIRE3 A
-    if (bit_is_set(DDR_BUTTON3_A, BIT_BUTTON3_A)) {
-      BIT_CLEAR(DDR_BUTTON3_A, BIT_BUTTON3_A);
-      BIT_CLEAR(PORT_BUTTON3_A, BIT_BUTTON3_A);
-    } else {
-      BIT_SET(DDR_BUTTON3_A, BIT_BUTTON3_A);
-      BIT_SET(PORT_BUTTON3_A, BIT_BUTTON3_A);
+// directions and buttons are held at least JOYSTICK_HOLD_MS, the
+// AUTOFIRE bits only run the autofire, which has its own timing
+#define HOLD_MASK  (UP | DOWN | LEFT | RIGHT | BUTTON | SPACE | BUTTON2 | BUTTON3)
+#define HOLD_BITS  10 ///< hold_edge per bit up to BUTTON3
+
+_Static_assert(HOLD_MASK < (1 << HOLD_BITS), "HOLD_BITS misses a bit of HOLD_MASK");
+
+static Joystick hold_in[NUMBER_PORTS];             ///< latest state of the driver
+static Joystick hold_out[NUMBER_PORTS];            ///< stretched state
+static uint8_t  hold_ext[NUMBER_PORTS] = {1, 1};   ///< latest ext of the driver
+static uint16_t hold_edge[NUMBER_PORTS][HOLD_BITS]; ///< time of the last edge per bit [ms]
+
+static Joystick stretch(Port port, Joystick in) {
+  uint16_t now = timer_millis();
+  Joystick out = hold_out[port];
+  Joystick diff = (in ^ out) & HOLD_MASK;
+
+  // follow an edge right away, unless the last
+  // edge of this bit is younger than the hold time
+  for (uint8_t i = 0; diff != 0; i++, diff >>= 1) {
+    if ((diff & 1) && (uint16_t)(now - hold_edge[port][i]) >= JOYSTICK_HOLD_MS) {
+      out ^= (1 << i);
+      hold_edge[port][i] = now;
     }
   }
 
-  // ===================================
-  //  CONTROL PORT B
-  // ===================================
+  out = (out & HOLD_MASK) | (in & ~HOLD_MASK);
+  hold_out[port] = out;
 
-  if (autofire_b == 1) {
-    // toggle FIRE B
-    if (bit_is_set(DDR_BUTTON_B, BIT_BUTTON_B)) {
-      BIT_CLEAR(DDR_BUTTON_B, BIT_BUTTON_B);
-    } else {
-      BIT_SET(DDR_BUTTON_B, BIT_BUTTON_B);
-    }
+  return out;
+}
+
+void joystick_update_port(Port port, Joystick state, uint8_t ext) {
+  hold_in[port] = state;
+  hold_ext[port] = ext;
+
+  commit(port, stretch(port, state), ext);
+}
+
+void joystick_poll(void) {
+  // edges which had to wait for the hold time
+  for (Port p = PORT_A; p < NUMBER_PORTS; p++) {
+    if ((hold_in[p] ^ hold_out[p]) & HOLD_MASK)
+      joystick_update_port(p, hold_in[p], hold_ext[p]);
   }
+}
+
+static inline uint8_t autofire_step(Port port) {
+  uint8_t running = af_running[port];
+  uint8_t changed = 0;
 
-  if (autofire2_b == 1) {
-    // toggle FIRE2 B
-    if (bit_is_set(DDR_BUTTON2_B, BIT_BUTTON2_B)) {
-      BIT_CLEAR(DDR_BUTTON2_B, BIT_BUTTON2_B);
-      BIT_CLEAR(PORT_BUTTON2_B, BIT_BUTTON2_B);
-    } else {
-      BIT_SET(DDR_BUTTON2_B, BIT_BUTTON2_B);
-      BIT_SET(PORT_BUTTON2_B, BIT_BUTTON2_B);
+  for (Fire f = FIRE_1; f < NUMBER_FIRES; f++) {
+    if ((running & _BV(f)) == 0)
+      continue;
+
+    Autofire *a = &af[port][f];
+
+    // press at the start of the period, release after the duty cycle
+    if (++a->time >= a->period) {
+      a->time = 0;
+      af_pressed[port] |= _BV(f);
+      changed = 1;
+    } else if (a->time == a->on) {
+      af_pressed[port] &= ~_BV(f);
+      changed = 1;
     }
   }
 
-  if (autofire3_b == 1) {
-    // toggle FIRE3 B
-    if (bit_is_set(DDR_BUTTON3_B, BIT_BUTTON3_B)) {
-      BIT_CLEAR(DDR_BUTTON3_B, BIT_BUTTON3_B);
-      BIT_CLEAR(PORT_BUTTON3_B, BIT_BUTTON3_B);
-    } else {
-      BIT_SET(DDR_BUTTON3_B, BIT_BUTTON3_B);
-      BIT_SET(PORT_BUTTON3_B, BIT_BUTTON3_B);
-    }
+  return changed;
+}
+
+void joystick_tick(void) {
+  uint8_t changed = autofire_step(PORT_A) | autofire_step(PORT_B);
+
+  if (changed == 0)
+    return;
+
+  // write the autofire lines of both ports at once,
+  // pot lines are driven high, DDR & PORT
+  uint8_t run_a = af_running[PORT_A], on_a = run_a & af_pressed[PORT_A];
+  uint8_t run_b = af_running[PORT_B], on_b = run_b & af_pressed[PORT_B];
+  Masks m[NUMBER_IO];
+
+  for (uint8_t io = IO_B; io < NUMBER_IO; io++) {
+    m[io].own_ddr = fire_mask(PORT_A, io, run_a) | fire_mask(PORT_B, io, run_b);
+    m[io].ddr = fire_mask(PORT_A, io, on_a) | fire_mask(PORT_B, io, on_b);
+    m[io].own_port = m[io].own_ddr & pot_mask(io);
+    m[io].port = m[io].ddr & pot_mask(io);
   }
+
+  write_masks(m);
 }
@@ -25,6 +25,8 @@
 
 #include <inttypes.h>
 
+#include "enums.h"
+
 enum Joystick_State {
   // joystick data
   UP        = (1 << 0), ///< up
@@ -38,9 +40,39 @@ enum Joystick_State {
   BUTTON2   = (1 << 7), ///< fire button2
   AUTOFIRE2 = (1 << 8), ///< auto fire button2
   BUTTON3   = (1 << 9), ///< fire button3
-  AUTOFIRE3 = (1 << 10) ///< auto fire button3
+  AUTOFIRE3 = (1 << 10), ///< auto fire button3
+  AUTOFIRE_RATE = (1 << 11) ///< next autofire rate (on press)
 };
 
+/// \brief fire lines with autofire
+typedef enum {
+  FIRE_1,      ///< fire button
+  FIRE_2,      ///< fire button2 (pot x)
+  FIRE_3,      ///< fire button3 (pot y)
+
+  NUMBER_FIRES ///< number of fire lines
+} Fire;
+
+/// \brief autofire rates
+typedef enum {
+  RATE_5HZ,    ///< 5 Hz
+  RATE_8HZ,    ///< 8 Hz
+  RATE_10HZ,   ///< 10 Hz
+  RATE_12HZ,   ///< 12.5 Hz
+  RATE_15HZ,   ///< 15 Hz
+  RATE_20HZ,   ///< 20 Hz
+  RATE_25HZ,   ///< 25 Hz
+
+  NUMBER_RATES ///< number of rates
+} AutofireRate;
+
+#ifndef JOYSTICK_HOLD_MS
+#define JOYSTICK_HOLD_MS 20 ///< min time a press or release is held, one PAL frame [ms]
+#endif
+
+#define AUTOFIRE_RATE_DEFAULT RATE_10HZ ///< rate after reset
+#define AUTOFIRE_DUTY_DEFAULT 50        ///< pressed part of the period after reset [%]
+
 /// \brief Joystick, holds the state of one joystick
 typedef uint16_t Joystick;
 
@@ -54,20 +86,50 @@ typedef uint16_t Joystick;
 extern void joystick_init(void);
 
 /**
-* @brief Update Joystick state
+* @brief Update Joystick state of one port
 *
-* @param [in] port_a byte representing the state of Port A
-* @param [in] port_b byte representing the state of Port A
+* Call as soon as new data of the port is there,
+* the other port isn't touched (except SPACE on port B).
+* Each press and release of a direction or button is held at
+* least JOYSTICK_HOLD_MS, so the C64 sees even short taps.
 *
-* The bit (see Joystick_State) are set inside the respective parameter
+* @param [in] port PORT_A or PORT_B (C64 control port)
+* @param [in] state bits representing the state of the port (see Joystick_State)
+* @param [in] ext 0 ... paddle uses the pot lines / 1 ... BUTTON2 & BUTTON3 enabled
 */
-extern void joystick_update(Joystick port_a, uint8_t ext_a,
-                            Joystick port_b, uint8_t ext_b);
+extern void joystick_update_port(Port port, Joystick state, uint8_t ext);
 
 /**
-* @brief poll joystick routines (for autofire)
-* @note This function is called by timer interrupt routine
+* @brief write the lines of a port again, even if the state is unchanged
+*
+* For code which drove the lines itself meanwhile (paddle_calibrate()).
+*
+* @param [in] port PORT_A or PORT_B (C64 control port)
+*/
+extern void joystick_refresh(Port port);
+
+/**
+* @brief commit edges which had to wait for the hold time
+* @note Call every millisecond (scheduler, see main)
 */
 extern void joystick_poll(void);
 
+/**
+* @brief set rate and duty cycle of an autofire line
+*
+* AUTOFIRE_RATE steps through the rates of all lines of a port.
+*
+* @param [in] port PORT_A or PORT_B (C64 control port)
+* @param [in] fire fire line
+* @param [in] rate AutofireRate
+* @param [in] duty pressed part of the period [%]
+*/
+extern void joystick_set_autofire(Port port, Fire fire, uint8_t rate, uint8_t duty);
+
+/**
+* @brief autofire timebase, presses and releases autofire lines
+* @note Called every millisecond by the timer interrupt routine
+*/
+extern void joystick_tick(void);
+
 #endif
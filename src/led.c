@@ -21,25 +21,40 @@
 /// @brief  led
 //=============================================================================
 #include <avr/pgmspace.h>
-#include <avr/wdt.h>
-#include <util/delay.h>
+#include <util/atomic.h>
 
 #include "ioconfig.h"
 
 #include "led.h"
 
-const uint8_t FLASH_DATA[NUMBER_LED_STATES][7] PROGMEM = {
-// on, off,  on, off, on, off
-  {0,  0,  0,  0,  0,  0,  0}, ///< OFF
-  {0,  0,  0,  0,  0,  0,  0}, ///< ON
-  {2, 12,  0,  0,  0,  0,  0}, ///< F1
-  {2,  4,  2, 12,  0,  0,  0}  ///< F2
+#define PATTERN_STEPS  7      ///< max steps of a pattern
+#define PATTERN_ON     _BV(0) ///< first step is on
+#define PATTERN_REPEAT _BV(1) ///< start again after the last step
+
+/// \brief led pattern, steps toggle the led
+typedef struct {
+  uint8_t flags;                ///< PATTERN_*
+  uint8_t steps[PATTERN_STEPS]; ///< step time [LED_TICK_MS], 0 ... end
+} Pattern;
+
+const Pattern PATTERNS[NUMBER_LED_STATES + NUMBER_LED_OVERLAYS] PROGMEM = {
+// flags                          on, off, on, off, on, off
+  {0,                             {0}},                   ///< OFF
+  {PATTERN_ON,                    {0}},                   ///< ON
+  {PATTERN_ON | PATTERN_REPEAT,   {13, 77}},              ///< F1
+  {PATTERN_ON | PATTERN_REPEAT,   {13, 26, 13, 77}},      ///< F2
+  {PATTERN_ON | PATTERN_REPEAT,   {13, 26, 13, 26, 13, 77}}, ///< F3
+// flags                          off, on, off, on, off
+  {0,                             {20, 5, 45}},           ///< QUICK1
+  {0,                             {20, 5, 5, 5, 45}},     ///< QUICK2
+  {0,                             {20, 5, 5, 5, 5, 5, 45}} ///< QUICK3
 };
 
-static LED_State led_state = LED_OFF;
-static uint8_t led_flash_index = 0;
-static uint8_t led_flash_timer = 0;
-static uint8_t led_lock = 0;
+static volatile LED_State led_state = LED_OFF;
+static volatile uint8_t led_pattern = LED_OFF; ///< running pattern, mode or overlay
+static volatile uint8_t led_step = 0;          ///< step of the pattern
+static volatile uint8_t led_timer = 0;         ///< time left in the step [LED_TICK_MS]
+static volatile uint8_t led_level = 0;         ///< led is on
 
 static void led_set(uint8_t on) {
   if (on) {
@@ -49,34 +64,28 @@ static void led_set(uint8_t on) {
   }
 }
 
+static void led_start(uint8_t pattern) {
+  led_pattern = pattern;
+  led_step = 0;
+  led_timer = pgm_read_byte(&PATTERNS[pattern].steps[0]);
+  led_level = (pgm_read_byte(&PATTERNS[pattern].flags) & PATTERN_ON) ? 1 : 0;
+
+  led_set(led_level);
+}
+
 void led_init(void) {
   BIT_SET(DDR_LED, BIT_LED);   // enable output
   BIT_CLEAR(PORT_LED, BIT_LED);  // set to 0 => LED OFF
 }
 
 void led_switch(LED_State state) {
-  led_state = state;
-
-  switch (led_state) {
-    case LED_OFF:
-    case LED_ON:
-      led_set(led_state); // switch led
-      break;
-
-    case LED_BLINK1:
-      led_set(1);
-      break;
-
-    case LED_BLINK2:
-      led_set(1);
-      break;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    led_state = state;
 
-    case NUMBER_LED_STATES:
-      break;
+    // a running overlay switches back to the new state
+    if (led_pattern < NUMBER_LED_STATES)
+      led_start(state);
   }
-
-  led_flash_index = 0; // start counting
-  led_flash_timer = 0; // reset timer
 }
 
 void led_setnextstate(void) {
@@ -94,57 +103,28 @@ LED_State led_get_state(void) {
   return (led_state);
 }
 
-void led_quick_blink(uint8_t number) {
-  led_lock = 1;
-
-  led_set(0);
-  _delay_ms(200);
-  wdt_reset();
-
-  for (uint8_t i = 0; i < number; i++) {
-    led_set(1);
-    _delay_ms(50);
-
-    wdt_reset();
-
-    led_set(0);
-    _delay_ms(50);
+void led_overlay(LED_Overlay overlay) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    led_start(NUMBER_LED_STATES + overlay);
   }
-
-  _delay_ms(400);
-   wdt_reset();
-
-  led_lock = 0;
-
-  led_switch(led_state);
 }
 
-void led_poll(void) {
-
-  // if ON or OFF do nothing
-  if (led_state == LED_OFF || led_state == LED_ON || led_lock)
+void led_tick(void) {
+  // steady pattern, or step not over yet
+  if (led_timer == 0 || --led_timer != 0)
     return;
 
-  // set timer
-  if (led_flash_timer == 0) {
-    uint8_t wait = pgm_read_byte(&(FLASH_DATA[led_state][led_flash_index]));
-
-    if (wait) {
-      led_flash_timer = wait;
-    } else {
-      led_flash_index = 0; // start from beginning
-      led_set(1);
-    }
-
-    // count down timer
-  } else {
-
-    led_flash_timer --;
-
-    if (led_flash_timer == 0) {
-      // toggle led
-      led_flash_index ++;
-      led_set((led_flash_index + 1)  % 2);
-    }
+  // next step, toggle led
+  if (++led_step < PATTERN_STEPS &&
+      (led_timer = pgm_read_byte(&PATTERNS[led_pattern].steps[led_step])) != 0) {
+    led_level ^= 1;
+    led_set(led_level);
+    return;
   }
+
+  // end of pattern
+  if (led_pattern >= NUMBER_LED_STATES)
+    led_start(led_state); // overlay done, back to the state
+  else if (pgm_read_byte(&PATTERNS[led_pattern].flags) & PATTERN_REPEAT)
+    led_start(led_pattern);
 }
@@ -30,11 +30,22 @@ typedef enum {
   LED_ON,       ///< LED is ON
   LED_BLINK1,   ///< LED flashes once
   LED_BLINK2,   ///< LED flashes twice
-  // LED_BLINK3,   ///< LED blinks tree times
+  LED_BLINK3,   ///< LED flashes three times
 
   NUMBER_LED_STATES
 } LED_State;
 
+/// \brief one shot patterns, shown over the state pattern
+typedef enum {
+  LED_QUICK1,   ///< LED off, flashes once, off
+  LED_QUICK2,   ///< LED off, flashes twice, off
+  LED_QUICK3,   ///< LED off, flashes three times, off
+
+  NUMBER_LED_OVERLAYS
+} LED_Overlay;
+
+#define LED_TICK_MS 10 ///< time base of the patterns [ms]
+
 /**
 * @brief init LED
 *
@@ -61,14 +72,18 @@ extern void led_setnextstate(void);
 extern LED_State led_get_state(void);
 
 /**
-* @brief quick flash
+* @brief show a one shot pattern, then the state again
+*
+* Doesn't block, the pattern runs in led_tick().
+*
+* @param overlay LED_QUICK1 / LED_QUICK2 / LED_QUICK3
 */
-extern void led_quick_blink(uint8_t number);
+extern void led_overlay(LED_Overlay overlay);
 
 /**
-* @brief poll led routines (for flashing)
-* @note This function is called by timer interrupt routine
+* @brief led pattern sequencer
+* @note Called every LED_TICK_MS by the timer interrupt routine
 */
-extern void led_poll(void);
+extern void led_tick(void);
 
 #endif
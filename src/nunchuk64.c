@@ -24,6 +24,7 @@
 #include <stdio.h>
 
 #include <avr/interrupt.h>
+#include <avr/power.h>
 #include <avr/wdt.h>
 // #include <util/delay.h>
 
@@ -37,6 +38,7 @@
 #include "joystick.h"
 #include "paddle.h"
 #include "timer.h"
+#include "sched.h"
 
 // drivers
 #include "driver_nes_classic.h"
@@ -46,26 +48,30 @@
 static volatile Driver *driver[NUMBER_PORTS] = {NULL, NULL};
 static volatile uint8_t ext[NUMBER_PORTS] = {1, 1};
 
-static Driver *GetDriver(ControllerID id) {
-  switch (id) {
-    case ID_Nunchuck:
-      return &drv_nunchuk;
-
-    case ID_Wii_Classic:
-    case ID_Wii_Classic_Pro:
-    case ID_NES_Classic_Mini_Clone_Encrypted:
-    case ID_8Bitdo_SF30:
-      return &drv_wii_classic;
-
-    case MAX_IDs:
-    case ID_Unknown:
-      return NULL;
-  }
+static ContollerData cd[NUMBER_PORTS];                    ///< controller data
+static Joystick joystick[NUMBER_PORTS] = {0, 0};          ///< joystick data
+static Paddle paddle[NUMBER_PORTS] = {{0, 0}, {0, 0}};    ///< paddle data
+static uint8_t switched_ports = FALSE;                    ///< TRUE ... port A & B swapped
+static Port bus_port = PORT_B;   ///< port which currently owns the i2c bus
+static uint8_t bus_busy = FALSE; ///< read in progress on bus_port
+
+/// \brief driver per DriverType
+static Driver * const DRIVER_MAP[NUMBER_DRIVERS] = {
+  NULL,             // DRIVER_NONE
+  &drv_nunchuk,     // DRIVER_NUNCHUK
+  &drv_wii_classic  // DRIVER_CLASSIC
+};
 
-  return NULL;
+static Driver *GetDriver(ControllerID id) {
+  return DRIVER_MAP[controller_driver(id)];
 }
 
 static void init(void) {
+  // ===================================
+  // run at full 8 MHz (CKDIV8 fuse set)
+  // ===================================
+  clock_prescale_set(clock_div_1);
+
   // ===================================
   // init modules
   // ===================================
@@ -99,6 +105,15 @@ static Port switch_port(Port p) {
     return PORT_A;
 }
 
+static uint8_t port_due(Port p) {
+  // empty port, look for a controller
+  if (driver[p] == NULL)
+    return controller_probe_due(p);
+
+  // next sample prepared?
+  return (controller_wait(p) == 0) ? TRUE : FALSE;
+}
+
 static void handle_paddle_enabled(uint8_t switched_ports) {
   for (Port p = PORT_A; p <= PORT_B; p++) {
 
@@ -110,104 +125,179 @@ static void handle_paddle_enabled(uint8_t switched_ports) {
 
     if (driver[p] != NULL && driver[p]->get_paddle_enabled() == TRUE) {
       ext[p] = 0;
+      paddle_set_mode(setport, (led_get_state() == LED_BLINK3) ? PADDLE_MOUSE : PADDLE_POT);
       paddle_start(setport);
     } else {
+      paddle_set_mode(setport, PADDLE_POT);
       paddle_stop(setport);
       ext[p] = 1;
     }
   }
 }
 
-int main(void) {
+static void commit_port(Port p) {
+  // switched mode?
+  Port out = (switched_ports == TRUE) ? switch_port(p) : p;
+
+  joystick_update_port(out, joystick[p], ext[p]);
+  paddle_update_port(out, &paddle[p]);
+}
+
+static void commit_all(void) {
+  commit_port(PORT_A);
+  commit_port(PORT_B);
+}
+
+static void poll_port(Port p) {
   // ===================================
-  // init everything
+  // read data from controller
   // ===================================
-  init();
+  if (bus_busy == TRUE) {
+    // the other port owns the bus
+    if (bus_port != p)
+      return;
+
+    ReadState rs = controller_poll();
 
+    if (rs == READ_BUSY)
+      return;
 
-  ContollerData cd[NUMBER_PORTS];  // controller data
-  Joystick joystick[NUMBER_PORTS] = {0, 0}; // joystick data
-  Paddle paddle[NUMBER_PORTS] = {{0, 0}, {0, 0}}; // joystick data
-  uint8_t switched_ports = FALSE;
+    bus_busy = FALSE;
+
+    // no good data within the hold window? -> delete driver
+    // single bad frames are retried, the last good data is kept
+    if (rs == READ_FAILED) {
+      driver[p] = NULL;
+      joystick[p] = 0; // delete old data
+      handle_paddle_enabled(switched_ports);
+      commit_port(p);
+
+      // translate the controller date to joystick data
+    } else if (rs == READ_OK && driver[p] != NULL) {
+      driver[p]->get_joystick_state(&cd[p], &joystick[p]);
+      driver[p]->get_paddle_state(&cd[p], &paddle[p]);
+
+      // out to the pins right away, don't wait for the other port
+      commit_port(p);
+    }
+
+    // give the other port a chance, this one prepares its sample now
+    return;
+  }
 
   // ===================================
-  // MAIN LOOP
-  while (1) {
+  // bus is free, but is this port due?
+  // ===================================
+  if (port_due(p) == FALSE)
+    return;
 
-    // ================
-    // calm watchdog down
-    // ================
-    wdt_reset();
+  bus_port = p;
 
-    // ================
-    // read button
-    // ================
-    button_debounce();
+  // select I2C port
+  controller_select(p);
+
+  // ===================================
+  // detect controller type, set driver
+  // ===================================
+  if (driver[p] == NULL) {
+    ControllerID id;
+
+    // a missing or stuck controller returns quickly with an error
+    get_id(&id);
+    driver[p] = GetDriver(id);
+
+    // new driver found
+    if (driver[p] != NULL) {
+      controller_set_check(p, driver[p]->frame_valid);
+      handle_paddle_enabled(switched_ports);
+      commit_port(p);
+    }
+
+    // ===================================
+    // the controller has prepared the next
+    // sample, data is ready in one of the
+    // next passes
+    // ===================================
+  } else {
+    controller_request(&cd[p]);
+    bus_busy = TRUE;
+  }
+}
+
+static void task_port_a(void) {
+  poll_port(PORT_A);
+}
+
+static void task_port_b(void) {
+  poll_port(PORT_B);
+}
 
+static void task_button(void) {
+  switch (button_get_event()) {
     // short press
-    if (button_get() == TRUE) {
+    case BUTTON_RELEASE:
       // set to next led state
       led_setnextstate();
 
       handle_paddle_enabled(switched_ports); // handle paddle enabled
-    }
+      commit_all();
+      break;
 
     // long press
-    if (button_get_long() == TRUE) {
+    case BUTTON_LONG:
       switched_ports = (switched_ports == FALSE) ? TRUE : FALSE;
 
       handle_paddle_enabled(switched_ports); // handle paddle disabled
+      commit_all();
 
-      led_quick_blink(switched_ports ? 2 : 1);
-    }
+      led_overlay(switched_ports ? LED_QUICK2 : LED_QUICK1);
+      break;
 
-    // ===================================
-    // communiate with controllers
-    // ===================================
-    for (uint8_t p = PORT_A; p <= PORT_B; p++) {
-      // select I2C port
-      selector_switch(p);
-      // _delay_ms(1);
-
-      // ===================================
-      // detect controller type, set driver
-      // ===================================
-      if (driver[p] == NULL) {
-        driver[p] = GetDriver(get_id());
-
-        // new driver found
-        if (driver[p] != NULL) {
-          handle_paddle_enabled(switched_ports);
-        }
-
-        // ===================================
-        // read data from controller
-        // ===================================
-      } else {
-        // controller read failed? -> delete driver
-        if (controller_read(&cd[p]) == FALSE) {
-          driver[p] = NULL;
-          joystick[p] = 0; // delete old data
-          handle_paddle_enabled(switched_ports);
-        }
-      }
+    // held
+    case BUTTON_HOLD: {
+      // fit the paddle windows to this C64 (it must read the pots)
+      uint8_t a = paddle_calibrate(PORT_A);
+      uint8_t b = paddle_calibrate(PORT_B);
 
-      // translate the controller date to joystick data
-      if (driver[p] != NULL) {
-        driver[p]->get_joystick_state(&cd[p], &joystick[p]);
-        driver[p]->get_paddle_state(&cd[p], &paddle[p]);
-      }
+      // the POT lines are BUTTON2/BUTTON3 of a joystick port
+      joystick_refresh(PORT_A);
+      joystick_refresh(PORT_B);
+
+      if (a || b)
+        led_overlay(LED_QUICK3);
+      break;
     }
 
-    // switched mode?
-    if (switched_ports == FALSE) {
+    default:
+      break;
+  }
+}
 
-      joystick_update(joystick[PORT_A], ext[PORT_A], joystick[PORT_B], ext[PORT_B]);
-      paddle_update(&paddle[PORT_A], &paddle[PORT_B]);
-    } else {
-      joystick_update(joystick[PORT_B], ext[PORT_B], joystick[PORT_A], ext[PORT_A]);
-      paddle_update(&paddle[PORT_B], &paddle[PORT_A]);
-    }
+int main(void) {
+  // ===================================
+  // init everything
+  // ===================================
+  init();
+
+  // ===================================
+  // tasks, in order of priority
+  //        function       period [ms]  deadline [ms]
+  // ===================================
+  sched_add(task_port_a,   0,           2);  // controller port A, when its sample is ready
+  sched_add(task_port_b,   0,           2);  // controller port B, when its sample is ready
+  sched_add(joystick_poll, 1,           1);  // held joystick edges
+  sched_add(task_button,   10,          5);  // button events
+
+  // ===================================
+  // MAIN LOOP
+  while (1) {
+
+    // ================
+    // calm watchdog down
+    // ================
+    wdt_reset();
+
+    sched_run();
   }
 
   //  MAIN LOOP
@@ -21,12 +21,133 @@
 /// @brief  analog paddle input part
 //=============================================================================
 #include <inttypes.h>
+#include <avr/eeprom.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 
 #include "ioconfig.h"
 #include "enums.h"
 
 #include "paddle.h"
+#include "timer.h"
+
+// Timer0/Timer1 run at clk/8, one count = 1 us at 8 MHz. POT 0 is at
+// "start" counts after the SENSE edge, one POT step takes period / 512.
+#define P1_WINDOW        184  ///< port A: counts from INT0 to POT 0 (uncalibrated)
+#define P2_WINDOW        216  ///< port B: counts from INT1 to POT 0 (uncalibrated)
+#define P2_WINDOW_MAX    256  ///< port B: Timer0 overflows at the window start
+
+#define POT_CENTER       128  ///< POT value after start
+
+#define MOTION_SHIFT       7  ///< fraction bits of the interpolated POT values
+#define MOTION_MAX_MS     50  ///< samples further apart don't move in between [ms]
+
+#define MOUSE_DEAD        32  ///< stick dead zone [axis]
+#define MOUSE_CURVE       10  ///< speed = (deflection - dead zone)^2 >> MOUSE_CURVE
+#define MOUSE_MAX_SPEED  192  ///< 1.5 counts per ms: 30 per PAL / 25 per NTSC frame [1 / 2^MOTION_SHIFT]
+#define MOUSE_OFFSET    0x40  ///< POT of mouse position 0, away from the window ends
+
+#define CAL_CYCLES        16  ///< measuring cycles averaged
+#define CAL_TRIES         64  ///< max SENSE cycles looked at
+#define CAL_TIMEOUT     2000  ///< max time between two SENSE edges [us]
+#define CAL_TIMEOUT_MS     3  ///< CAL_TIMEOUT, polled on the window timer [ms]
+#define CAL_MAX_MS        50  ///< no new measuring cycle after this time [ms]
+#define CAL_JITTER         8  ///< max polling gap of an exact time stamp [us]
+#define CAL_EARLY         32  ///< lines raised this long after INT while timing the release [us]
+#define CAL_PROBE         32  ///< lines raised this long after the release while timing the lead [us]
+#define CAL_RELEASE_TOL   16  ///< release on the window timer vs. on the free running one [us]
+#define CAL_LEAD_MAX     100  ///< max time from the compare to SENSE high [us]
+#define CAL_PERIOD_MIN   480  ///< NTSC: 512 / 1.023 MHz = 500 us
+#define CAL_PERIOD_MAX   540  ///< PAL:  512 / 0.985 MHz = 520 us
+#define CAL_VALID       0xA6  ///< marker of a stored calibration
+
+/// \brief SID timing of one port, measured by paddle_calibrate()
+typedef struct {
+  uint16_t period; ///< SID measuring cycle, 512 SID clocks [counts]
+  uint16_t start;  ///< SENSE edge to POT 0 [counts]
+  uint8_t valid;   ///< CAL_VALID ... measured
+} Calibration;
+
+static Calibration calibration[NUMBER_PORTS] = {
+  {512, P1_WINDOW, 0}, // PORT_A
+  {512, P2_WINDOW, 0}  // PORT_B
+};
+
+static Calibration EEMEM ee_calibration[NUMBER_PORTS]; ///< stored calibration
+
+static volatile uint16_t ocr1a_load = P1_WINDOW + POT_CENTER; ///< precalculated OCR1A value (A XPOT)
+static volatile uint16_t ocr1b_load = P1_WINDOW + POT_CENTER; ///< precalculated OCR1B value (A YPOT)
+static volatile uint8_t ocr0a_load = POT_CENTER;              ///< precalculated OCR0A value, after overflow (B XPOT)
+static volatile uint8_t ocr0b_load = POT_CENTER;              ///< precalculated OCR0B value, after overflow (B YPOT)
+static volatile uint8_t tcnt0_load = 256 - P2_WINDOW;         ///< precalculated TCNT0 value, overflow at POT 0
+static volatile uint8_t tccr0a_load =                         ///< precalculated TCCR0A value, after overflow
+  _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1) | _BV(COM0B0);
+
+/// \brief motion of one port between two samples
+typedef struct {
+  int16_t pos[2];  ///< POT x/y now [1 / 2^MOTION_SHIFT]
+  int16_t vel[2];  ///< POT x/y per ms [1 / 2^MOTION_SHIFT]
+  uint8_t pot[2];  ///< POT x/y of the last sample
+  uint16_t time;   ///< time of the last sample [ms]
+  uint8_t steps;   ///< ms left to move, one sample interval
+} Motion;
+
+static volatile Motion motion[NUMBER_PORTS]; ///< interpolation, moved by paddle_tick()
+
+/// \brief 1351 mouse of one port
+typedef struct {
+  uint16_t pos[2]; ///< position x/y, wraps [1 / 2^MOTION_SHIFT counts]
+  int16_t vel[2];  ///< counts x/y per ms [1 / 2^MOTION_SHIFT]
+  uint8_t pot[2];  ///< POT x/y loaded
+} Mouse;
+
+static volatile Mouse mouse[NUMBER_PORTS];    ///< mouse, moved by paddle_tick()
+static volatile uint8_t mode[NUMBER_PORTS];   ///< PaddleMode of the ports
+
+static volatile uint8_t a_enabled = 0xff;
+static volatile uint8_t b_enabled = 0xff;
+
+/// timer counts from POT 0 to pot
+static uint16_t pot_counts(Port port, uint8_t pot) {
+  return ((uint32_t)pot * calibration[port].period) >> 9;
+}
+
+/// precalculate the timer values of the POT lines of a port
+static void load_port(Port port, uint8_t pot_x, uint8_t pot_y) {
+  if (port == PORT_A) {
+    // ===================================
+    //  CONTROL PORT A
+    // ===================================
+    uint16_t start = calibration[PORT_A].start;
+    uint16_t ocr_x = start + pot_counts(PORT_A, pot_x);
+    uint16_t ocr_y = start + pot_counts(PORT_A, pot_y);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      ocr1a_load = ocr_x;
+      ocr1b_load = ocr_y;
+    }
+
+  } else {
+    // ===================================
+    //  CONTROL PORT B
+    // ===================================
+    uint16_t ocr_x = pot_counts(PORT_B, pot_x);
+    uint16_t ocr_y = pot_counts(PORT_B, pot_y);
+    uint8_t com = 0;
+
+    // past the 8 bit timer (PAL: POT 252 ... 255) keeps clearing, the
+    // SID counts to the end and reads 255, the others set on compare
+    com |= (ocr_x > 255) ? _BV(COM0A1) : _BV(COM0A1) | _BV(COM0A0);
+    com |= (ocr_y > 255) ? _BV(COM0B1) : _BV(COM0B1) | _BV(COM0B0);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      ocr0a_load = (ocr_x > 255) ? 255 : ocr_x;
+      ocr0b_load = (ocr_y > 255) ? 255 : ocr_y;
+      tcnt0_load = (uint8_t)(256 - calibration[PORT_B].start);
+      tccr0a_load = com;
+    }
+  }
+}
 
 void paddle_init(void) {
   // SID sensing port
@@ -54,23 +175,18 @@ void paddle_init(void) {
   EIMSK &= ~_BV(INT1);                // disable INT1
   EICRA &= ~(_BV(ISC11) | _BV(ISC10));
   EICRA |= _BV(ISC11);                // ISC11:ISC10 == 10, @negedge
-}
-
-#define P1_MIN_TIMER     23
-#define P1_MAX_TIMER     51
-#define P1_RANGE         (P1_MAX_TIMER - P1_MIN_TIMER)
 
-#define P2_MIN_TIMER     27
-#define P2_MAX_TIMER     55
-#define P2_RANGE         (P2_MAX_TIMER - P2_MIN_TIMER)
+  // measured SID timing
+  for (Port p = PORT_A; p <= PORT_B; p++) {
+    Calibration c;
 
-static volatile uint8_t ocr1a_load = P1_MIN_TIMER + (P1_RANGE / 2); ///< precalculated OCR1A value (A XPOT)
-static volatile uint8_t ocr1b_load = P1_MIN_TIMER + (P1_RANGE / 2); ///< precalculated OCR1B value (A YPOT)
-static volatile uint8_t ocr0a_load = P2_MIN_TIMER + (P2_RANGE / 2); ///< precalculated OCR0A value (B XPOT)
-static volatile uint8_t ocr0b_load = P2_MIN_TIMER + (P2_RANGE / 2); ///< precalculated OCR0B value (B YPOT)
+    eeprom_read_block(&c, &ee_calibration[p], sizeof(c));
+    if (c.valid == CAL_VALID)
+      calibration[p] = c;
 
-static volatile uint8_t a_enabled = 0xff;
-static volatile uint8_t b_enabled = 0xff;
+    load_port(p, POT_CENTER, POT_CENTER);
+  }
+}
 
 void paddle_start(Port port) {
 
@@ -81,8 +197,8 @@ void paddle_start(Port port) {
 
     TCCR1B = 0;
 
-    OCR1A = P1_MIN_TIMER + (P1_RANGE / 2);
-    OCR1B = P1_MIN_TIMER + (P1_RANGE / 2);
+    OCR1A = ocr1a_load;
+    OCR1B = ocr1b_load;
 
     DDR_PADDLE_A_X  |= (_BV(BIT_PADDLE_A_X) | _BV(BIT_PADDLE_A_Y));   // enable POTX/POTY as outputs
     PORT_PADDLE_A_X |= (_BV(BIT_PADDLE_A_X) | _BV(BIT_PADDLE_A_Y));   // output "1" on both
@@ -99,8 +215,8 @@ void paddle_start(Port port) {
 
     TCCR0B = 0; // Port B
 
-    OCR0A = P2_MIN_TIMER + (P2_RANGE / 2); // Port B
-    OCR0B = P2_MIN_TIMER + (P2_RANGE / 2); // Port B
+    OCR0A = ocr0a_load; // Port B
+    OCR0B = ocr0b_load; // Port B
 
     DDR_PADDLE_B_X  |= (_BV(BIT_PADDLE_B_X) | _BV(BIT_PADDLE_B_Y));   // enable POTX/POTY as outputs
     PORT_PADDLE_B_X |= (_BV(BIT_PADDLE_B_X) | _BV(BIT_PADDLE_B_Y));   // output "1" on both
@@ -134,144 +250,576 @@ void paddle_stop(Port port) {
     PORT_PADDLE_B_X &= ~(_BV(BIT_PADDLE_B_X) | _BV(BIT_PADDLE_B_Y));
 
     EIMSK &= ~_BV(INT1);  // disable INT1
+    TIMSK0 &= ~_BV(TOIE0); // disable a pending window start
 
     b_enabled = 0;
   }
 }
 
-void paddle_update(Paddle *port_a, Paddle *port_b) {
+/// 1351: position modulo 64 in bits 1 ... 6 of the POT value,
+/// the software only looks at the differences
+static uint8_t mouse_pot(uint16_t pos) {
+  return MOUSE_OFFSET + (((pos >> MOTION_SHIFT) & 0x3F) << 1);
+}
 
-  // ===================================
-  //  CONTROL PORT A
-  // ===================================
+/// speed of a stick axis: dead zone, then quadratic up to the max,
+/// a frame never moves 32 counts or more (modulo 64)
+static int16_t mouse_speed(uint16_t axis) {
+  int16_t d = (int16_t)axis - 512;
+  uint16_t e = (d < 0) ? -d : d;
+  uint32_t speed;
 
-  // ocr1a_load  x
-  // ocr1b_load  y
+  if (e <= MOUSE_DEAD)
+    return 0;
 
-  // ocr0a_load  x
-  // ocr0b_load  y
-  uint16_t a_x = port_a->axis_x;
-  uint16_t a_y = port_a->axis_y;
-  uint16_t b_x = port_b->axis_x;
-  uint16_t b_y = port_b->axis_y;
+  e -= MOUSE_DEAD;
+  speed = ((uint32_t)e * e) >> MOUSE_CURVE;
+
+  if (speed > MOUSE_MAX_SPEED)
+    speed = MOUSE_MAX_SPEED;
+
+  return (d < 0) ? -(int16_t)speed : (int16_t)speed;
+}
 
-  if (a_x > 1024)
-    a_x = 1024;
+/// move the mouse of a port by one ms
+static void mouse_move(Port port) {
+  volatile Mouse *m = &mouse[port];
+  uint8_t pot[2];
 
-  if (a_y > 1024)
-    a_y = 1024;
+  for (uint8_t i = 0; i < 2; i++) {
+    m->pos[i] += m->vel[i];
+    pot[i] = mouse_pot(m->pos[i]);
+  }
 
-  if (b_x > 1024)
-    b_x = 1024;
+  if (pot[0] != m->pot[0] || pot[1] != m->pot[1]) {
+    m->pot[0] = pot[0];
+    m->pot[1] = pot[1];
+    load_port(port, pot[0], pot[1]);
+  }
+}
 
-  if (b_y > 1024)
-    b_y = 1024;
+/// POT values at rest: center, or where the mouse is
+static void load_rest(Port port) {
+  if (mode[port] == PADDLE_MOUSE)
+    load_port(port, mouse[port].pot[0], mouse[port].pot[1]);
+  else
+    load_port(port, POT_CENTER, POT_CENTER);
+}
 
-  ocr1a_load = P1_RANGE - ((a_x * P1_RANGE) / 1024) + P1_MIN_TIMER;
-  ocr1b_load = P1_RANGE - ((a_y * P1_RANGE) / 1024) + P1_MIN_TIMER;
+void paddle_set_mode(Port port, PaddleMode new_mode) {
+  if (mode[port] == new_mode)
+    return;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    mode[port] = new_mode;
+    motion[port].steps = 0;
+    mouse[port].vel[0] = 0;
+    mouse[port].vel[1] = 0;
+    mouse[port].pot[0] = mouse_pot(mouse[port].pos[0]);
+    mouse[port].pot[1] = mouse_pot(mouse[port].pos[1]);
+  }
 
-  ocr0a_load = P2_RANGE - ((b_x * P2_RANGE) / 1024) + P2_MIN_TIMER;
-  ocr0b_load = P2_RANGE - ((b_y * P2_RANGE) / 1024) + P2_MIN_TIMER;
-/*
-  if (ocr1a_load < P1_MIN_TIMER)
-    ocr1a_load = P1_MIN_TIMER;
-  else if (ocr1a_load > P1_MAX_TIMER)
-    ocr1a_load = P1_MAX_TIMER;
+  load_rest(port);
+}
 
-  if (ocr1b_load < P1_MIN_TIMER)
-    ocr1b_load = P1_MIN_TIMER;
-  else if (ocr1b_load > P1_MAX_TIMER)
-    ocr1b_load = P1_MAX_TIMER;
+void paddle_update_port(Port port, const Paddle *paddle) {
+  uint16_t x = paddle->axis_x;
+  uint16_t y = paddle->axis_y;
 
-  if (ocr0a_load < P2_MIN_TIMER)
-    ocr0a_load = P2_MIN_TIMER;
-  else if (ocr0a_load > P2_MAX_TIMER)
-    ocr0a_load = P2_MAX_TIMER;
+  if (mode[port] == PADDLE_MOUSE) {
+    int16_t vx = mouse_speed(x);
+    int16_t vy = mouse_speed(y);
 
-  if (ocr0b_load < P2_MIN_TIMER)
-    ocr0b_load = P2_MIN_TIMER;
-  else if (ocr0b_load > P2_MAX_TIMER)
-    ocr0b_load = P2_MAX_TIMER;
- */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      mouse[port].vel[0] = vx;
+      mouse[port].vel[1] = vy;
+    }
+    return;
+  }
+
+  if (x > 1023)
+    x = 1023;
+
+  if (y > 1023)
+    y = 1023;
+
+  // 0 ... 1023 => POT 255 ... 0, one POT step per 4
+  uint8_t pot[2] = { 255 - (x >> 2), 255 - (y >> 2) };
+  uint16_t now = timer_millis();
+  uint16_t dt = now - motion[port].time;
+  int16_t vel[2] = { 0, 0 };
+
+  // velocity from the last sample, none after a pause
+  if (dt > 0 && dt <= MOTION_MAX_MS) {
+    for (uint8_t i = 0; i < 2; i++)
+      vel[i] = ((int16_t)(pot[i] - motion[port].pot[i]) * (1 << MOTION_SHIFT)) / (int16_t)dt;
+  }
+
+  // the sample is exact, paddle_tick() moves on from there for at
+  // most one sample interval: overshoot is bounded by the last step
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    for (uint8_t i = 0; i < 2; i++) {
+      motion[port].pos[i] = (int16_t)pot[i] << MOTION_SHIFT;
+      motion[port].vel[i] = vel[i];
+      motion[port].pot[i] = pot[i];
+    }
+    motion[port].time = now;
+    motion[port].steps = (vel[0] || vel[1]) ? dt : 0;
+  }
+
+  load_port(port, pot[0], pot[1]);
 }
 
-/// SID measuring cycle detected.
-///
-/// 1. SID pulls POTX low\n
-/// 2. SID waits 256 cycles us\n
-/// 3. SID releases POTX\n
-/// 4. 0 to 255 cycles until the cap is charged\n
-///
-/// This handler stops the Timer1, clears OC1A/OC1B outputs,
-/// loads the timer with values precalculated in potmouse_movt()
-/// and starts the timer.
-///
-/// OC1A/OC1B (YPOT/XPOT) lines will go up by hardware.
-/// Normal SID cycle is 512us. Timer will overflow not before 65535us.
-/// Next cycle will begin before that so there's no need to stop the timer.
-/// Output compare match interrupts are thus not used.
+void paddle_tick(void) {
+  for (Port p = PORT_A; p <= PORT_B; p++) {
+    volatile Motion *m = &motion[p];
+    uint8_t pot[2];
 
-ISR(INT0_vect) {
-  // ===========================================================
-  // SID started to measure the pots, uuu
-  // disable INT0 until the measurement cycle is complete
+    if (mode[p] == PADDLE_MOUSE) {
+      mouse_move(p);
+      continue;
+    }
 
+    if (m->steps == 0)
+      continue;
 
-  // ===========================================================
-  // stop the timer
-  TCCR1B = 0;
+    m->steps--;
 
-  // clear OC1A/OC1B:
-  // 1. set output compare to clear OC1A/OC1B ("10" in table 37 on page 97)
-  TCCR1A = _BV(COM1A1) | _BV(COM1B1);
-  // 2. force output compare to make it happen
-  TCCR1C |= _BV(FOC1A) | _BV(FOC1B);
+    for (uint8_t i = 0; i < 2; i++) {
+      int32_t pos = (int32_t)m->pos[i] + m->vel[i];
 
-  // Set OC1A/OC1B on Compare Match (Set output to high level)
-  // WGM13:0 = 00, normal mode: count from BOTTOM to MAX
-  TCCR1A = _BV(COM1A1) | _BV(COM1A0) | _BV(COM1B1) | _BV(COM1B0);
+      if (pos < 0)
+        pos = 0;
+      if (pos > ((int32_t)255 << MOTION_SHIFT))
+        pos = (int32_t)255 << MOTION_SHIFT;
 
-  // load the timer
-  TCNT1 = 0;
+      m->pos[i] = pos;
+      pot[i] = pos >> MOTION_SHIFT;
+    }
 
-  // init the output compare values
-  OCR1A = ocr1a_load;
-  OCR1B = ocr1b_load;
+    load_port(p, pot[0], pot[1]);
+  }
+}
 
-  // start timer with prescaler clk/8 (1 count = 1us)
-  // TCCR1B |= _BV(CS11) | _BV(CS10);
-  TCCR1B |= _BV(CS11);
+#define EDGE_NONE   0 ///< no edge within CAL_TIMEOUT
+#define EDGE_EXACT  1 ///< time stamp within CAL_JITTER of the edge
+#define EDGE_LATE   2 ///< an interrupt ran in between, time stamp unknown
+
+/// wait for a SENSE edge, which leaves the line at level.
+/// Interrupts stay on, a gap in the polling around the edge
+/// makes the time stamp useless.
+static uint8_t sense_edge(Port port, uint8_t level, uint16_t *stamp) {
+  uint8_t flag = (port == PORT_A) ? _BV(INTF0) : _BV(INTF1);
+  uint16_t begin = TCNT1;
+  uint16_t polled = begin;
+
+  while ((uint16_t)(polled - begin) < CAL_TIMEOUT) {
+    if (EIFR & flag) {
+      uint16_t t = TCNT1;
+      uint8_t high = (port == PORT_A) ? bit_is_set(PIN_SENSE_A, BIT_SENSE_A)
+                                      : bit_is_set(PIN_SENSE_B, BIT_SENSE_B);
+      EIFR = flag;
+
+      if ((high ? 1 : 0) == level) {
+        *stamp = t;
+        return ((uint16_t)(t - polled) <= CAL_JITTER) ? EDGE_EXACT : EDGE_LATE;
+      }
+    }
+    polled = TCNT1;
+  }
+
+  return EDGE_NONE;
 }
 
-ISR(INT1_vect) {
+/// window timer of a port: counts since INT0 / INT1 started it,
+/// port B only after the overflow at w
+static uint16_t window_now(Port port, uint16_t w) {
+  return (port == PORT_A) ? TCNT1 : w + TCNT0;
+}
 
-  // ===========================================================
-  // SID started to measure the pots, uuu
-  // disable INT1 until the measurement cycle is complete
+/// raise the POT lines of a port w + o counts after INT0 / INT1,
+/// port B: window start (overflow) at w
+static void load_probe(Port port, uint16_t w, uint8_t o) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (port == PORT_A) {
+      ocr1a_load = w + o;
+      ocr1b_load = w + o;
+    } else {
+      ocr0a_load = o;
+      ocr0b_load = o;
+      tcnt0_load = (uint8_t)(256 - w);
+      tccr0a_load = _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1) | _BV(COM0B0);
+    }
+  }
+}
 
+/// wait for SENSE at level, time stamp on the window timer.
+/// Same as sense_edge(), but with the paddle ISRs running.
+static uint8_t sense_level(Port port, uint8_t level, uint16_t w, uint16_t *stamp) {
+  uint16_t begin = timer_millis();
+  uint16_t polled = window_now(port, w);
+
+  do {
+    uint8_t high = (port == PORT_A) ? bit_is_set(PIN_SENSE_A, BIT_SENSE_A)
+                                    : bit_is_set(PIN_SENSE_B, BIT_SENSE_B);
+    uint16_t t = window_now(port, w);
+
+    if ((high ? 1 : 0) == level) {
+      *stamp = t;
+      return ((uint16_t)(t - polled) <= CAL_JITTER) ? EDGE_EXACT : EDGE_LATE;
+    }
+    polled = t;
+  } while ((uint16_t)(timer_millis() - begin) < CAL_TIMEOUT_MS);
+
+  return EDGE_NONE;
+}
 
-  // ===========================================================
-  // stop the timer
-  TCCR0B = 0;
+/// average SENSE rise on the window timer, the paddle output of the
+/// port running with the lines raised at w + o: exact rises within
+/// lo ... hi count, the others are from cycles the timer didn't see
+/// (CIA on the other port, interrupt in between)
+static uint8_t time_rise(Port port, uint16_t w, uint8_t o,
+                         uint16_t lo, uint16_t hi, uint16_t *rise) {
+  uint32_t sum = 0;
+  uint8_t cycles = 0;
+  uint16_t begin = timer_millis();
+  uint16_t t;
+
+  load_probe(port, w, o);
+  paddle_start(port);
+
+  for (uint8_t i = 0; i < CAL_TRIES && cycles < CAL_CYCLES &&
+                      (uint16_t)(timer_millis() - begin) < CAL_MAX_MS; i++) {
+    // discharging: INT started the window timer
+    if (sense_level(port, 0, w, &t) == EDGE_NONE)
+      break;
+
+    uint8_t edge = sense_level(port, 1, w, &t);
+    if (edge == EDGE_NONE)
+      break;
+
+    if (edge == EDGE_EXACT && t >= lo && t <= hi) {
+      sum += t;
+      cycles++;
+    }
+  }
+
+  paddle_stop(port);
+
+  *rise = sum / CAL_CYCLES;
+  return (cycles == CAL_CYCLES);
+}
+
+uint8_t paddle_calibrate(Port port) {
+  uint8_t restart_a = (a_enabled == 1);
+  uint8_t restart_b = (b_enabled == 1);
+  uint32_t period = 0;
+  uint32_t low = 0;
+  uint8_t cycles = 0;
+  uint16_t fall, rise, next;
+  uint16_t release, lead;
+  uint16_t begin;
+  uint8_t edge;
+  Calibration c;
+
+  // POT lines of the port as they are now, BUTTON2/BUTTON3 in joystick mode
+  uint8_t pot_bits = (port == PORT_A) ? (_BV(BIT_PADDLE_A_X) | _BV(BIT_PADDLE_A_Y))
+                                      : (_BV(BIT_PADDLE_B_X) | _BV(BIT_PADDLE_B_Y));
+  uint8_t pot_ddr  = ((port == PORT_A) ? DDR_PADDLE_A_X  : DDR_PADDLE_B_X)  & pot_bits;
+  uint8_t pot_port = ((port == PORT_A) ? PORT_PADDLE_A_X : PORT_PADDLE_B_X) & pot_bits;
+
+  paddle_stop(PORT_A);
+  paddle_stop(PORT_B);
+
+  // the tick doesn't load the port meanwhile
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    motion[port].steps = 0;
+    mouse[port].vel[0] = 0;
+    mouse[port].vel[1] = 0;
+  }
+
+  // both POT lines high: SENSE only follows the SID
+  // (low while it discharges, high from the release on)
+  if (port == PORT_A) {
+    TCCR1A = 0;
+    DDR_PADDLE_A_X  |= (_BV(BIT_PADDLE_A_X) | _BV(BIT_PADDLE_A_Y));
+    PORT_PADDLE_A_X |= (_BV(BIT_PADDLE_A_X) | _BV(BIT_PADDLE_A_Y));
+    EICRA &= ~(_BV(ISC01) | _BV(ISC00));
+    EICRA |= _BV(ISC00);                // ISC01:ISC00 == 01, any edge
+  } else {
+    TCCR0B = 0;
+    TCCR0A = 0;
+    DDR_PADDLE_B_X  |= (_BV(BIT_PADDLE_B_X) | _BV(BIT_PADDLE_B_Y));
+    PORT_PADDLE_B_X |= (_BV(BIT_PADDLE_B_X) | _BV(BIT_PADDLE_B_Y));
+    EICRA &= ~(_BV(ISC11) | _BV(ISC10));
+    EICRA |= _BV(ISC10);                // ISC11:ISC10 == 01, any edge
+  }
+
+  // time stamps: Timer1 free running at clk/8 (1 count = 1us)
+  TCCR1B = 0;
+  TCCR1A = 0;
+  TCNT1 = 0;
+  TCCR1B = _BV(CS11);
+
+  // at most CAL_TRIES SID cycles or CAL_MAX_MS, the tick keeps running,
+  // cycles with an interrupt at one of their edges are skipped
+  // (the CIA may switch the POT lines to the other port in between)
+  EIFR = (port == PORT_A) ? _BV(INTF0) : _BV(INTF1);
+  begin = timer_millis();
+  edge = sense_edge(port, 0, &fall);
+
+  for (uint8_t i = 0; edge != EDGE_NONE && i < CAL_TRIES && cycles < CAL_CYCLES &&
+                      (uint16_t)(timer_millis() - begin) < CAL_MAX_MS; i++) {
+    uint8_t exact = (edge == EDGE_EXACT);
+
+    if ((edge = sense_edge(port, 1, &rise)) == EDGE_NONE)
+      break;
+    exact &= (edge == EDGE_EXACT);
+
+    if ((edge = sense_edge(port, 0, &next)) == EDGE_NONE)
+      break;
+    exact &= (edge == EDGE_EXACT);
+
+    uint16_t p = next - fall;
+    if (exact && p >= CAL_PERIOD_MIN && p <= CAL_PERIOD_MAX) {
+      period += p;
+      low += rise - fall;
+      cycles++;
+    }
+    fall = next;
+  }
+
+  TCCR1B = 0;
+
+  // back to @negedge
+  if (port == PORT_A) {
+    EICRA &= ~(_BV(ISC01) | _BV(ISC00));
+    EICRA |= _BV(ISC01);
+  } else {
+    EICRA &= ~(_BV(ISC11) | _BV(ISC10));
+    EICRA |= _BV(ISC11);
+  }
 
-  // clear OC0A/OC0B:
-  // 1. set output compare to clear OC0A/OC0B ("10" in table 37 on page 97)
-  TCCR0A = _BV(COM0A1) | _BV(COM0B1);
-  // 2. force output compare to make it happen
-  TCCR0B |= _BV(FOC0A) | _BV(FOC0B);
+  // the window timers as the paddle output runs them, ISR entry included:
+  // 1. lines raised early, SENSE rises with the release of the SID
+  // 2. lines raised CAL_PROBE after the release, SENSE rises a lead later
+  //    (ISR and compare to output, charging the line to the SENSE level)
+  if (cycles == CAL_CYCLES) {
+    low /= CAL_CYCLES;
+
+    if (low <= CAL_EARLY + CAL_RELEASE_TOL ||
+        !time_rise(port, CAL_EARLY, 0, low - CAL_RELEASE_TOL, low + CAL_RELEASE_TOL, &release) ||
+        !time_rise(port, release - CAL_EARLY, CAL_EARLY + CAL_PROBE,
+                   release + CAL_PROBE, release + CAL_PROBE + CAL_LEAD_MAX, &lead))
+      cycles = 0;
+  }
 
-  // Set OC0A/OC0B on Compare Match (Set output to high level)
-  // WGM13:0 = 00, normal mode: count from BOTTOM to MAX
-  TCCR0A = _BV(COM0A1) | _BV(COM0A0) | _BV(COM0B1) | _BV(COM0B0);
+  if (cycles == CAL_CYCLES) {
+    c.period = period / CAL_CYCLES;
+    lead -= release + CAL_PROBE;
+
+    // POT 0: line raised the lead before the SID releases it
+    if (release > lead && release - lead < c.period) {
+      c.start = release - lead;
+      if (port == PORT_B && c.start > P2_WINDOW_MAX)
+        c.start = P2_WINDOW_MAX;
+      c.valid = CAL_VALID;
+
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        calibration[port] = c;
+      }
+      eeprom_update_block(&c, &ee_calibration[port], sizeof(c));
+    } else {
+      cycles = 0;
+    }
+  }
 
-  // load the timer
-  TCNT0 = 0;
+  load_rest(port);
+
+  // give the POT lines back: inputs first, then the old levels
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (port == PORT_A) {
+      DDR_PADDLE_A_X  &= ~pot_bits;
+      PORT_PADDLE_A_X  = (PORT_PADDLE_A_X & ~pot_bits) | pot_port;
+      DDR_PADDLE_A_X  |= pot_ddr;
+    } else {
+      DDR_PADDLE_B_X  &= ~pot_bits;
+      PORT_PADDLE_B_X  = (PORT_PADDLE_B_X & ~pot_bits) | pot_port;
+      DDR_PADDLE_B_X  |= pot_ddr;
+    }
+  }
 
-  // init the output compare values
-  OCR0A = ocr0a_load;
-  OCR0B = ocr0b_load;
+  if (restart_a)
+    paddle_start(PORT_A);
+  if (restart_b)
+    paddle_start(PORT_B);
 
-  // start timer with prescaler clk/8 (1 count = 1us)
-  //TCCR0B |= _BV(CS01) | _BV(CS00);
-  TCCR0B |= _BV(CS01);
+  return (cycles == CAL_CYCLES) ? TRUE : FALSE;
+}
+
+/// SID measuring cycle detected.
+///
+/// 1. SID pulls POTX low\n
+/// 2. SID waits 256 cycles us\n
+/// 3. SID releases POTX\n
+/// 4. 0 to 255 cycles until the cap is charged\n
+///
+/// This handler stops the Timer1, clears OC1A/OC1B outputs, starts
+/// the timer at clk/8 (1 count = 1us) and loads the compare values
+/// precalculated in paddle_update_port().
+///
+/// OC1A/OC1B (YPOT/XPOT) lines will go up by hardware.
+/// Normal SID cycle is 512us. Timer will overflow not before 65535us.
+/// Next cycle will begin before that so there's no need to stop the timer.
+/// Output compare match interrupts are thus not used.
+///
+/// The 8 bit Timer0 of port B can not count the whole window: it is
+/// loaded to overflow at the window start, outputs are only cleared on
+/// compare before. TIMER0_OVF switches them to set on compare.
+
+/// The handlers are naked: they only use r24 and ldi/lds/sts/in/out,
+/// which leave SREG alone, so there is no prologue to wait for.
+/// Cycles from the first instruction of the handler:
+///
+///   INT0: Timer1 starts after 21 cycles, OCR1A/OCR1B follow (+16)
+///   INT1: Timer0 starts after 13 cycles, OCR0A/OCR0B and the window
+///         interrupt follow (+11)
+///
+/// plus 4 cycles interrupt response, 3 for the jmp of the vector table
+/// and 0 ... 3 for the instruction the edge arrived in. The compare
+/// values are loaded after the start, the first match is far away.
+
+ISR(INT0_vect, ISR_NAKED) {
+  asm volatile(
+    "push r24"              "\n\t"  // 2
+
+    // stop the timer, load it with 0 (high byte first)
+    "ldi  r24, 0"           "\n\t"  // 1
+    "sts  %[tccr1b], r24"   "\n\t"  // 2
+    "sts  %[tcnt1h], r24"   "\n\t"  // 2
+    "sts  %[tcnt1l], r24"   "\n\t"  // 2
+
+    // clear OC1A/OC1B: clear on compare, force compare
+    "ldi  r24, %[clear]"    "\n\t"  // 1
+    "sts  %[tccr1a], r24"   "\n\t"  // 2
+    "ldi  r24, %[force]"    "\n\t"  // 1
+    "sts  %[tccr1c], r24"   "\n\t"  // 2
+
+    // set OC1A/OC1B on compare match, normal mode
+    "ldi  r24, %[set]"      "\n\t"  // 1
+    "sts  %[tccr1a], r24"   "\n\t"  // 2
+
+    // start timer with prescaler clk/8 (1 count = 1us)
+    "ldi  r24, %[start]"    "\n\t"  // 1
+    "sts  %[tccr1b], r24"   "\n\t"  // 2 => 21
+
+    // output compare values (high byte first)
+    "lds  r24, %[ocra]+1"   "\n\t"
+    "sts  %[ocr1ah], r24"   "\n\t"
+    "lds  r24, %[ocra]"     "\n\t"
+    "sts  %[ocr1al], r24"   "\n\t"
+    "lds  r24, %[ocrb]+1"   "\n\t"
+    "sts  %[ocr1bh], r24"   "\n\t"
+    "lds  r24, %[ocrb]"     "\n\t"
+    "sts  %[ocr1bl], r24"   "\n\t"
+
+    "pop  r24"              "\n\t"
+    "reti"                  "\n\t"
+    :
+    : [tccr1a] "n" (_SFR_MEM_ADDR(TCCR1A)),
+      [tccr1b] "n" (_SFR_MEM_ADDR(TCCR1B)),
+      [tccr1c] "n" (_SFR_MEM_ADDR(TCCR1C)),
+      [tcnt1h] "n" (_SFR_MEM_ADDR(TCNT1H)),
+      [tcnt1l] "n" (_SFR_MEM_ADDR(TCNT1L)),
+      [ocr1ah] "n" (_SFR_MEM_ADDR(OCR1AH)),
+      [ocr1al] "n" (_SFR_MEM_ADDR(OCR1AL)),
+      [ocr1bh] "n" (_SFR_MEM_ADDR(OCR1BH)),
+      [ocr1bl] "n" (_SFR_MEM_ADDR(OCR1BL)),
+      [clear]  "n" (_BV(COM1A1) | _BV(COM1B1)),
+      [force]  "n" (_BV(FOC1A) | _BV(FOC1B)),
+      [set]    "n" (_BV(COM1A1) | _BV(COM1A0) | _BV(COM1B1) | _BV(COM1B0)),
+      [start]  "n" (_BV(CS11)),
+      [ocra]   "i" (&ocr1a_load),
+      [ocrb]   "i" (&ocr1b_load)
+  );
+}
+
+ISR(INT1_vect, ISR_NAKED) {
+  asm volatile(
+    "push r24"              "\n\t"  // 2
+
+    // stop the timer
+    "ldi  r24, 0"           "\n\t"  // 1
+    "out  %[tccr0b], r24"   "\n\t"  // 1
+
+    // clear OC0A/OC0B: clear on compare, force compare (timer stopped)
+    // and keep clearing on compare until the window starts
+    "ldi  r24, %[clear]"    "\n\t"  // 1
+    "out  %[tccr0a], r24"   "\n\t"  // 1
+    "ldi  r24, %[force]"    "\n\t"  // 1
+    "out  %[tccr0b], r24"   "\n\t"  // 1
+
+    // load the timer, overflow at the window start
+    "lds  r24, %[tcnt]"     "\n\t"  // 2
+    "out  %[tcnt0], r24"    "\n\t"  // 1
+
+    // start timer with prescaler clk/8 (1 count = 1us)
+    "ldi  r24, %[start]"    "\n\t"  // 1
+    "out  %[tccr0b], r24"   "\n\t"  // 1 => 13
+
+    // output compare values
+    "lds  r24, %[ocra]"     "\n\t"
+    "out  %[ocr0a], r24"    "\n\t"
+    "lds  r24, %[ocrb]"     "\n\t"
+    "out  %[ocr0b], r24"    "\n\t"
+
+    // window start interrupt
+    "ldi  r24, %[tov]"      "\n\t"
+    "out  %[tifr0], r24"    "\n\t"
+    "ldi  r24, %[toie]"     "\n\t"
+    "sts  %[timsk0], r24"   "\n\t"
+
+    "pop  r24"              "\n\t"
+    "reti"                  "\n\t"
+    :
+    : [tccr0a] "I" (_SFR_IO_ADDR(TCCR0A)),
+      [tccr0b] "I" (_SFR_IO_ADDR(TCCR0B)),
+      [tcnt0]  "I" (_SFR_IO_ADDR(TCNT0)),
+      [ocr0a]  "I" (_SFR_IO_ADDR(OCR0A)),
+      [ocr0b]  "I" (_SFR_IO_ADDR(OCR0B)),
+      [tifr0]  "I" (_SFR_IO_ADDR(TIFR0)),
+      [timsk0] "n" (_SFR_MEM_ADDR(TIMSK0)),
+      [clear]  "n" (_BV(COM0A1) | _BV(COM0B1)),
+      [force]  "n" (_BV(FOC0A) | _BV(FOC0B)),
+      [start]  "n" (_BV(CS01)),
+      [tov]    "n" (_BV(TOV0)),
+      [toie]   "n" (_BV(TOIE0)),
+      [tcnt]   "i" (&tcnt0_load),
+      [ocra]   "i" (&ocr0a_load),
+      [ocrb]   "i" (&ocr0b_load)
+  );
+}
+
+#if ISR_NESTING
+#define WINDOW_ISR_FLAGS ISR_NOBLOCK
+#else
+#define WINDOW_ISR_FLAGS ISR_BLOCK
+#endif
+
+// interruptible: INT0 must not wait for it, a compare passed
+// meanwhile is forced below, the next overflow is 256 us away
+ISR(TIMER0_OVF_vect, WINDOW_ISR_FLAGS) {
+  // ===========================================================
+  // window start of port B, once per measurement cycle
+  TIMSK0 &= ~_BV(TOIE0);
+
+  // Set OC0A/OC0B on Compare Match (Set output to high level),
+  // keep clearing a line past the timer
+  TCCR0A = tccr0a_load;
+
+  // compare already passed while entering (POT 0 ... few): set now
+  if (OCR0A <= TCNT0)
+    TCCR0B |= _BV(FOC0A);
+  if (OCR0B <= TCNT0)
+    TCCR0B |= _BV(FOC0B);
 }
@@ -34,6 +34,14 @@ typedef struct {
   uint16_t axis_y; ///< [0 - 1023]  0 ... right / 1023 ...left
 } Paddle;
 
+/// \brief what the POT lines of a port show
+typedef enum {
+  PADDLE_POT,         ///< analog paddles, the axis is the POT value
+  PADDLE_MOUSE,       ///< 1351 mouse (proportional), the axis is the speed
+
+  NUMBER_PADDLE_MODES ///< number of modes
+} PaddleMode;
+
 /**
 * @brief init paddle-related IOs and interrupts
 */
@@ -50,8 +58,50 @@ extern void paddle_start(Port port);
 extern void paddle_stop(Port port);
 
 /**
-* @brief update paddle state
+* @brief switch the POT lines of a port between paddles and mouse
+*
+* @param port PORT_A or PORT_B (C64 control port)
+* @param mode PADDLE_POT / PADDLE_MOUSE
+*/
+extern void paddle_set_mode(Port port, PaddleMode mode);
+
+/**
+* @brief update paddle state of one port
+*
+* PADDLE_POT: the sample is time stamped, paddle_tick() moves the POT
+* values on with the velocity to the previous sample until the next one
+* is due.
+*
+* PADDLE_MOUSE: the axes are a stick, 512 ... center, up and right are
+* larger. paddle_tick() moves the mouse with the speed of the deflection.
+*
+* @param port PORT_A or PORT_B (C64 control port)
+* @param paddle new paddle state
+*/
+extern void paddle_update_port(Port port, const Paddle *paddle);
+
+/**
+* @brief move the POT values between two samples, move the mouse
+* @note Called every millisecond by the timer interrupt routine
+*/
+extern void paddle_tick(void);
+
+/**
+* @brief measure the SID timing of one port, fit the window and store it
+*
+* Times the SENSE edges of CAL_CYCLES measuring cycles with the POT
+* lines high: the period gives the SID clock (PAL / NTSC). Then with the
+* paddle output of the port running, on its window timer: the release
+* of the lines, and the lead from a compare to SENSE high. POT 0 is
+* raised the lead before the release, POT 255 follows from the period.
+* Interrupts stay on, cycles with an interrupt at one of their edges
+* are skipped. Blocks the caller three times CAL_MAX_MS plus the
+* timeouts, at most 166 ms (about 30 ms with a SID running), the paddle
+* outputs of both ports pause meanwhile.
+*
+* @param port PORT_A or PORT_B (C64 control port)
+* @return TRUE ... calibrated and stored / FALSE ... no SID cycles seen, kept
 */
-extern void paddle_update(Paddle *port_a, Paddle *port_b);
+extern uint8_t paddle_calibrate(Port port);
 
 #endif
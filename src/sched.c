@@ -0,0 +1,82 @@
+//=============================================================================
+// *** Nunchuk64 ***
+// Copyright (c) Robert Grasböck, All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//=============================================================================
+/// @file   sched.c
+/// @author Robert Grasböck (robert.grasboeck@gmail.com)
+/// @date   October, 2026
+/// @brief  cooperative run to completion task scheduler
+//=============================================================================
+#include <stdint.h>
+
+#include "timer.h"
+
+#include "sched.h"
+
+/// \brief task state
+typedef struct {
+  TaskFunc run;      ///< task function
+  uint16_t period;   ///< release period [ms]
+  uint16_t deadline; ///< max start delay after release [ms]
+  uint16_t release;  ///< time of the next release [ms]
+  uint16_t missed;   ///< missed deadlines
+} Task;
+
+static Task    tasks[MAX_TASKS];
+static uint8_t number_tasks = 0;
+
+uint8_t sched_add(TaskFunc run, uint16_t period, uint16_t deadline) {
+  if (number_tasks >= MAX_TASKS)
+    return MAX_TASKS;
+
+  Task *t = &tasks[number_tasks];
+
+  t->run = run;
+  t->period = period;
+  t->deadline = deadline;
+  t->release = timer_millis();
+  t->missed = 0;
+
+  return number_tasks++;
+}
+
+void sched_run(void) {
+  for (uint8_t i = 0; i < number_tasks; i++) {
+    Task *t = &tasks[i];
+    uint16_t late = timer_millis() - t->release;
+
+    // not released yet
+    if ((int16_t)late < 0)
+      continue;
+
+    if (late > t->deadline && t->missed < UINT16_MAX)
+      t->missed ++;
+
+    // next release, don't catch up after an overrun
+    if (t->period == 0)
+      t->release += late;
+    else if (late >= t->period)
+      t->release += late + t->period - (late % t->period);
+    else
+      t->release += t->period;
+
+    t->run();
+  }
+}
+
+uint16_t sched_missed(uint8_t task) {
+  return (task < number_tasks) ? tasks[task].missed : 0;
+}
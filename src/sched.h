@@ -0,0 +1,61 @@
+//=============================================================================
+// *** Nunchuk64 ***
+// Copyright (c) Robert Grasböck, All rights reserved.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//=============================================================================
+/// @file   sched.h
+/// @author Robert Grasböck (robert.grasboeck@gmail.com)
+/// @date   October, 2026
+/// @brief  cooperative run to completion task scheduler
+//=============================================================================
+
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+#include <inttypes.h>
+
+#define MAX_TASKS 8 ///< number of tasks sched_add() accepts
+
+/// \brief a task, runs to completion
+typedef void (*TaskFunc)(void);
+
+/**
+* @brief add a task, the order of adding is the priority
+*
+* A task is released every period, and should start within
+* deadline after its release. Later starts count as missed.
+*
+* @param run task function
+* @param period [ms], 0 ... every pass of sched_run()
+* @param deadline [ms]
+* @return task number / MAX_TASKS ... no room left
+*/
+extern uint8_t sched_add(TaskFunc run, uint16_t period, uint16_t deadline);
+
+/**
+* @brief one pass, run all released tasks in order
+*
+* Call in the main loop.
+*/
+extern void sched_run(void);
+
+/**
+* @brief missed deadlines of a task
+* @param task task number of sched_add()
+* @return count, saturates at UINT16_MAX
+*/
+extern uint16_t sched_missed(uint8_t task);
+
+#endif
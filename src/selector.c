@@ -21,6 +21,7 @@
 /// @brief  selector for i2c bus
 //=============================================================================
 #include "ioconfig.h"
+#include "i2c_master.h"
 
 #include "selector.h"
 
@@ -33,6 +34,11 @@ void selector_init(void) {
 }
 
 void selector_switch(Port port) {
+  // timeout or bus error on the current port?
+  // free its bus before leaving, the other port isn't affected
+  if (i2c_get_fault())
+    i2c_recover();
+
   if (port == PORT_A) {
     BIT_CLEAR(PORT_SEL1, BIT_SEL1);   // set to 0
     BIT_SET(PORT_SEL2, BIT_SEL2);     // set to 1
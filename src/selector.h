@@ -34,6 +34,9 @@ extern void selector_init(void);
 /**
 * @brief select i2c device
 *
+* A timeout or bus error seen on the current port triggers a
+* bus recovery (i2c_recover) before switching.
+*
 * @param port PORT_A or PORT_B
 */
 extern void selector_switch(Port port);
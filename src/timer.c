@@ -21,29 +21,81 @@
 /// @brief  timer for different things
 //=============================================================================
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 
+#include "button.h"
 #include "joystick.h"
 #include "led.h"
+#include "paddle.h"
 
 #include "timer.h"
 
+#define TICK_US   (64 / (F_CPU / 1000000L)) ///< duration of one timer2 count
+
+static volatile uint16_t millis = 0; ///< milliseconds since start
+static uint8_t led_ms = 0;           ///< milliseconds since the last led tick
+
 void timer_init(void) {
-  // enable timer overflow interrupt for both Timer2
-  TIMSK2 |= _BV(TOIE2);
+  // CTC mode, count from 0 to OCR2A
+  TCCR2A = _BV(WGM21);
 
   // set timer2 counter initial value to 0
   TCNT2 = 0x00;
 
-  // start timer2 with /1024 prescaler
-  TCCR2B = _BV(CS22) | _BV(CS21);
+  // 8 MHz / 64 / 125 = 1 kHz
+  OCR2A = (F_CPU / 64 / 1000) - 1;
+
+  // enable compare match interrupt for Timer2
+  TIMSK2 |= _BV(OCIE2A);
+
+  // start timer2 with /64 prescaler
+  TCCR2B = _BV(CS22);
+}
+
+uint16_t timer_millis(void) {
+  uint16_t ms;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ms = millis;
+  }
+
+  return ms;
 }
 
-static inline void timer_poll(void) {
-  led_poll();
-  joystick_poll();
+uint16_t timer_micros(void) {
+  uint16_t ms;
+  uint8_t  ticks;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    ms = millis;
+    ticks = TCNT2;
+
+    // compare match already happened, but not serviced yet
+    if (bit_is_set(TIFR2, OCF2A) && ticks < OCR2A)
+      ms ++;
+  }
+
+  return ms * 1000U + ticks * TICK_US;
 }
 
-// timer2 overflow
-ISR(TIMER2_OVF_vect) {
-  timer_poll();
+#if ISR_NESTING
+#define TICK_ISR_FLAGS ISR_NOBLOCK
+#else
+#define TICK_ISR_FLAGS ISR_BLOCK
+#endif
+
+// timer2 compare match, every millisecond
+// interruptible: the paddle triggers (INT0/INT1) must not wait for it,
+// the next compare match is 1 ms away
+ISR(TIMER2_COMPA_vect, TICK_ISR_FLAGS) {
+  millis ++;
+
+  joystick_tick(); // autofire
+  button_tick();   // debounce
+  paddle_tick();   // paddle interpolation
+
+  if (++led_ms >= LED_TICK_MS) {
+    led_ms = 0;
+    led_tick();    // led patterns
+  }
 }
@@ -21,8 +21,31 @@
 /// @brief  timer for different things
 //=============================================================================
 
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <inttypes.h>
+
+#ifndef ISR_NESTING
+#define ISR_NESTING 1 ///< 1 ... tick, TWI and port B window ISRs let INT0/INT1 in / 0 ... blocking, for a comparison
+#endif
+
 /**
 * @brief init Timer
 *
 */
 extern void timer_init(void);
+
+/**
+* @brief milliseconds since timer_init()
+* @return time in ms, wraps after ~65 s, compare differences only
+*/
+extern uint16_t timer_millis(void);
+
+/**
+* @brief microseconds since timer_init(), 8 us resolution
+* @return time in us, wraps after ~65 ms, compare differences only
+*/
+extern uint16_t timer_micros(void);
+
+#endif